@@ -0,0 +1,242 @@
+/*
+ * Test Card - Motion and frame pacing pattern
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <SDL.h>
+
+#include "animate.h"
+#include "card.h"
+
+// one bin per millisecond, the last one collects everything longer
+#define HISTOGRAM_BINS 64
+
+static bool active;
+static bool frameId;
+static animateCallback callback;
+static int rate;
+static SDL_Surface *card;
+static struct text *text;
+static SDL_Rect counterBox;
+static int counterSize;
+static SDL_Rect lastBar;
+
+static Uint32 frame;
+static Uint32 startTicks, lastTicks;
+static Uint32 histogram[HISTOGRAM_BINS];
+static Uint32 intervals, late, skipped;
+static Uint32 minInterval, maxInterval;
+static Uint64 totalInterval;
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static void report(void)
+{
+  if (!intervals) return;
+
+  fwprintf(stdout, L"Frame pacing: %u frames at %d Hz (%.2f ms), %u late, %u skipped by the generator\n",
+           (unsigned)frame, rate, 1000. / rate, (unsigned)late, (unsigned)skipped);
+  fwprintf(stdout, L"Frame time min %u ms, avg %.2f ms, max %u ms\n",
+           (unsigned)minInterval, (double)totalInterval / intervals, (unsigned)maxInterval);
+
+  Uint32 peak = 1;
+  for (int i = 0; i < HISTOGRAM_BINS; ++i) {
+    if (histogram[i] > peak) peak = histogram[i];
+  }
+  for (int i = 0; i < HISTOGRAM_BINS; ++i) {
+    if (!histogram[i]) continue;
+    int bar = (int)((Uint64)histogram[i] * 50 / peak);
+    fwprintf(stdout, L"%s%3d ms %8u ", i == HISTOGRAM_BINS-1 ? ">=" : "  ", i, (unsigned)histogram[i]);
+    for (int j = 0; j < bar; ++j) fputwc(L'#', stdout);
+    fputwc(L'\n', stdout);
+  }
+}
+
+void animateStart(int r)
+{
+  active = true;
+  rate = maxi(1, r);
+  frame = 0;
+  startTicks = lastTicks = SDL_GetTicks();
+  memset(histogram, 0, sizeof(histogram));
+  intervals = late = skipped = 0;
+  minInterval = ~0u;
+  maxInterval = 0;
+  totalInterval = 0;
+  lastBar.w = lastBar.h = 0;
+}
+
+void animateStop(SDL_Surface *screen)
+{
+  if (!active) return;
+  report();
+  active = false;
+  if (card) {
+    SDL_BlitSurface(card, NULL, screen, NULL);
+    SDL_UpdateRect(screen, 0, 0, 0, 0);
+    SDL_FreeSurface(card);
+    card = NULL;
+  }
+}
+
+void animateQuit(void)
+{
+  if (active) report();
+  active = false;
+  if (card) {
+    SDL_FreeSurface(card);
+    card = NULL;
+  }
+}
+
+bool animating(void)
+{
+  return active;
+}
+
+void animateSetCard(SDL_Surface *screen, struct text *t, SDL_Rect counterArea)
+{
+  text = t;
+  if (card && (card->w != screen->w || card->h != screen->h)) {
+    SDL_FreeSurface(card);
+    card = NULL;
+  }
+  if (!card) {
+    SDL_PixelFormat *f = screen->format;
+    card = SDL_CreateRGBSurface(SDL_SWSURFACE, screen->w, screen->h, f->BitsPerPixel,
+                                f->Rmask, f->Gmask, f->Bmask, f->Amask);
+    if (!card) {
+      fprintf(stderr, "SDL_CreateRGBSurface: %s\n", SDL_GetError());
+      active = false;
+      return;
+    }
+  }
+  SDL_BlitSurface(screen, NULL, card, NULL);
+
+  // the counter box is sized for the widest number so that it never
+  // needs to be restored from the card
+  int w, h;
+  counterSize = maxi(8, counterArea.h / 2);
+  textSize(text, counterSize, 0, " 0000000 ", &w, &h);
+  counterBox.x = counterArea.x + (counterArea.w - w) / 2;
+  counterBox.y = counterArea.y + (counterArea.h - h) / 2;
+  counterBox.w = w;
+  counterBox.h = h;
+  lastBar.w = lastBar.h = 0;
+}
+
+void animateSetFrameId(bool on)
+{
+  frameId = on;
+}
+
+void animateSetCallback(animateCallback c)
+{
+  callback = c;
+}
+
+static void clipRect(SDL_Surface *screen, SDL_Rect *r)
+{
+  int x0 = maxi(r->x, 0), y0 = maxi(r->y, 0);
+  int x1 = mini(r->x + r->w, screen->w), y1 = mini(r->y + r->h, screen->h);
+  r->x = x0;
+  r->y = y0;
+  r->w = maxi(0, x1 - x0);
+  r->h = maxi(0, y1 - y0);
+}
+
+static void drawFrame(SDL_Surface *screen)
+{
+  SDL_Rect rects[4];
+  int count = 0;
+
+  // put back what was under the bar
+  if (lastBar.w && lastBar.h) {
+    SDL_Rect r = lastBar;
+    SDL_BlitSurface(card, &r, screen, &r);
+    rects[count++] = lastBar;
+  }
+
+  // a bar with black edges that moves its own width every frame
+  int bw = maxi(4, screen->w / 120);
+  int positions = (screen->w + bw - 1) / bw;
+  SDL_Rect bar = {(frame % positions) * bw, 0, bw, screen->h};
+  clipRect(screen, &bar);
+  SDL_Rect r = bar;
+  SDL_FillRect(screen, &r, SDL_MapRGB(screen->format, 0, 0, 0));
+  r = bar;
+  r.x += 1;
+  r.w = maxi(0, r.w - 2);
+  SDL_FillRect(screen, &r, SDL_MapRGB(screen->format, 255, 255, 255));
+  rects[count++] = bar;
+  lastBar = bar;
+
+  // over the bar so that it can always be read
+  if (frameId) {
+    r = cardDrawFrameId(screen, frame);
+    if (r.w) rects[count++] = r;
+  }
+
+  char buf[16];
+  sprintf(buf, " %07u ", (unsigned)(frame % 10000000));
+  SDL_Color black = {0, 0, 0, 0};
+  SDL_Color white = {255, 255, 255, 0};
+  drawTextShaded(text, screen, counterSize, counterBox.x, counterBox.y, buf, white, black);
+  r = counterBox;
+  clipRect(screen, &r);
+  rects[count++] = r;
+
+  SDL_UpdateRects(screen, count, rects);
+  if (callback) callback(screen, frame);
+}
+
+Uint32 animateFrame(SDL_Surface *screen)
+{
+  if (!active || !card) return 1000;
+
+  Uint32 now = SDL_GetTicks();
+  Uint32 due = startTicks + (Uint32)((Uint64)frame * 1000 / rate);
+  if ((Sint32)(now - due) < 0) {
+    return due - now;
+  }
+
+  // Fell more than a frame behind, e.g. the process was not scheduled.
+  // Skip ahead so the bar stays where it should be at this time.
+  Uint32 behind = (Uint32)((Uint64)(now - due) * rate / 1000);
+  if (behind) {
+    frame += behind;
+    skipped += behind;
+  }
+
+  drawFrame(screen);
+
+  now = SDL_GetTicks();
+  if (frame > 0) {
+    Uint32 interval = now - lastTicks;
+    ++histogram[mini(interval, HISTOGRAM_BINS-1)];
+    ++intervals;
+    totalInterval += interval;
+    if (interval < minInterval) minInterval = interval;
+    if (interval > maxInterval) maxInterval = interval;
+    if (interval * rate > 1500) ++late;
+  }
+  lastTicks = now;
+  ++frame;
+
+  due = startTicks + (Uint32)((Uint64)frame * 1000 / rate);
+  return (Sint32)(due - now) > 0 ? due - now : 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Test Card - Motion and frame pacing pattern
+ *
+ * Draws a bar that moves exactly its own width every frame and a frame
+ * counter over the static card. Dropped, repeated or torn frames show
+ * up as gaps, doubled bars or a broken bar on the display or in a
+ * capture of it. Only the rectangles that changed are copied to the
+ * screen with SDL_UpdateRects() and the time between frames is kept in
+ * a histogram that is printed when the animation stops.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_ANIMATE_H
+#define TESTCARD_ANIMATE_H
+
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "font.h"
+
+// Start animating at rate frames per second.
+void animateStart(int rate);
+
+// Stop animating, put the static card back on the screen and print
+// the frame time histogram.
+void animateStop(SDL_Surface *screen);
+
+// Print the histogram if still animating and release memory.
+void animateQuit(void);
+
+bool animating(void);
+
+// Also draw the frame number in every frame as a machine readable code
+// for tools/analyze.
+void animateSetFrameId(bool on);
+
+// Called with the screen and the frame number after every frame is
+// drawn, e.g. to publish it. NULL for none.
+typedef void (*animateCallback)(SDL_Surface *screen, Uint32 frame);
+void animateSetCallback(animateCallback callback);
+
+// Take a copy of the freshly rendered card on screen to draw the
+// animation over. The frame counter is drawn with text and centered
+// in counterArea.
+void animateSetCard(SDL_Surface *screen, struct text *text, SDL_Rect counterArea);
+
+// Draw the next frame if it is due. Returns the number of
+// milliseconds until the following one.
+Uint32 animateFrame(SDL_Surface *screen);
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Test Card - Buffer arena of a render context
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+// posix_memalign() and madvise()
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "arena.h"
+
+// Buffers this big are put in huge pages of this size when asked to.
+#define HUGE_PAGE (2 << 20)
+
+struct arena {
+  bool hugePages;
+  // the blocks that have data
+  struct arenaBlock *blocks;
+  struct arenaStats stats;
+};
+
+static inline size_t roundUp(size_t n, size_t a)
+{
+  return (n + a - 1) / a * a;
+}
+
+static void release(struct arena *arena, struct arenaBlock *block)
+{
+#ifdef _WIN32
+  _aligned_free(block->data);
+#else
+  free(block->data);
+#endif
+  ++arena->stats.releases;
+  arena->stats.bytes -= block->size;
+  if (block->huge) arena->stats.hugeBytes -= block->size;
+  --arena->stats.buffers;
+  block->data = NULL;
+  block->size = 0;
+  block->huge = false;
+}
+
+struct arena *arenaCreate(bool hugePages)
+{
+  struct arena *arena = calloc(1, sizeof(*arena));
+  if (!arena) return NULL;
+  arena->hugePages = hugePages;
+  return arena;
+}
+
+void arenaFree(struct arena *arena)
+{
+  if (!arena) return;
+  arenaReset(arena);
+  free(arena);
+}
+
+void *arenaGet(struct arena *arena, struct arenaBlock *block, size_t size, bool keep)
+{
+  ++arena->stats.requests;
+  if (block->data && block->size >= size) return block->data;
+
+  // whole cache lines, no two buffers share one
+  size = roundUp(size ? size : 1, ARENA_ALIGN);
+  size_t align = ARENA_ALIGN;
+  bool huge = arena->hugePages && size >= HUGE_PAGE;
+  if (huge) {
+    size = roundUp(size, HUGE_PAGE);
+    align = HUGE_PAGE;
+  }
+  void *data;
+#ifdef _WIN32
+  data = _aligned_malloc(size, align);
+#else
+  if (posix_memalign(&data, align, size)) data = NULL;
+#endif
+  if (!data) return NULL;
+#ifdef MADV_HUGEPAGE
+  // transparent huge pages, a hint that is fine to be ignored
+  if (huge) madvise(data, size, MADV_HUGEPAGE);
+#endif
+  ++arena->stats.allocations;
+
+  if (block->data) {
+    if (keep) memcpy(data, block->data, block->size);
+    // still linked, only the data changes
+    struct arenaBlock *next = block->next;
+    release(arena, block);
+    block->next = next;
+  } else {
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+  block->data = data;
+  block->size = size;
+  block->huge = huge;
+  arena->stats.bytes += size;
+  if (huge) arena->stats.hugeBytes += size;
+  ++arena->stats.buffers;
+  return data;
+}
+
+void arenaRelease(struct arena *arena, struct arenaBlock *block)
+{
+  if (!block->data) return;
+  for (struct arenaBlock **b = &arena->blocks; *b; b = &(*b)->next) {
+    if (*b == block) {
+      *b = block->next;
+      break;
+    }
+  }
+  release(arena, block);
+  block->next = NULL;
+}
+
+void arenaReset(struct arena *arena)
+{
+  while (arena->blocks) {
+    struct arenaBlock *block = arena->blocks;
+    arena->blocks = block->next;
+    release(arena, block);
+    block->next = NULL;
+  }
+}
+
+void arenaNote(struct arena *arena)
+{
+  ++arena->stats.allocations;
+}
+
+void arenaStats(const struct arena *arena, struct arenaStats *stats)
+{
+  *stats = arena->stats;
+}
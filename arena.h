@@ -0,0 +1,79 @@
+/*
+ * Test Card - Buffer arena of a render context
+ *
+ * Every buffer a render needs, the painter's queue and bitmaps, the
+ * text mask, the chroma planes, the scaler's taps and scratch and the
+ * 16-bit target, comes from the arena of its context. Buffers start on
+ * a 64-byte cache line, big ones can be backed by huge pages, and they
+ * are only ever grown: once the first render at a resolution has sized
+ * them, the following renders and mode changes reuse them without a
+ * single heap allocation. They are released together when the card
+ * changes resolution and when the context is freed.
+ *
+ * The arena counts what it allocates, and what its users note they
+ * allocated elsewhere, so that steady state rendering can be checked
+ * to allocate nothing.
+ *
+ * This does not depend on SDL.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_ARENA_H
+#define TESTCARD_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGN 64
+
+// A buffer of an arena, kept by its user. Only data and size are for
+// the user to read, data is NULL until the first arenaGet() and after
+// the arena is reset.
+struct arenaBlock {
+  void *data;
+  size_t size;
+  struct arenaBlock *next;
+  bool huge;
+};
+
+struct arenaStats {
+  // heap allocations made by or noted to the arena, and the buffers
+  // it has released
+  uint64_t allocations, releases;
+  // buffers asked for, most of them reused
+  uint64_t requests;
+  // held now, and how much of it is in huge pages
+  size_t bytes, hugeBytes;
+  int buffers;
+};
+
+struct arena;
+
+// An arena that backs buffers of 2 MB and more with huge pages when
+// asked to and the system has them. NULL when out of memory.
+struct arena *arenaCreate(bool hugePages);
+
+// Release every buffer and the arena.
+void arenaFree(struct arena *arena);
+
+// Make block at least size bytes. It is reused as it is when big
+// enough and otherwise replaced, with its contents copied over when
+// keep is set. Returns the data or NULL, with the block unchanged, when
+// out of memory.
+void *arenaGet(struct arena *arena, struct arenaBlock *block, size_t size, bool keep);
+
+// Give a block back before its user goes away.
+void arenaRelease(struct arena *arena, struct arenaBlock *block);
+
+// Release every block, e.g. when the resolution changes.
+void arenaReset(struct arena *arena);
+
+// Count a heap allocation made outside the arena on its behalf, e.g.
+// an SDL surface.
+void arenaNote(struct arena *arena);
+
+void arenaStats(const struct arena *arena, struct arenaStats *stats);
+
+#endif
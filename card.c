@@ -0,0 +1,1051 @@
+/*
+ * Test Card - Renderer library
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+
+#include "card.h"
+#include "frameid.h"
+#include "pool.h"
+
+const char * const CARD_MODE_NAME[CARD_MODES] = {
+  "RGB",
+  "YCbCr 4:4:4",
+  "YCbCr 4:2:2 h",
+  "YCbCr 4:2:2 v",
+  "YCbCr 4:2:0",
+};
+
+struct card {
+  struct text *text;
+  struct paint *paint;
+  struct pool *pool;
+  struct scale *scale;
+  // every buffer of the context, sized for a width by height card
+  struct arena *arena;
+  int width, height;
+  // 16 bits per channel copy of the gradients and gamma table, only
+  // while the options ask for it, kept for the next time when not
+  struct deep *deep, *deepStore;
+  // the card seen through the caller's buffer and what the scaler
+  // simulation renders to
+  SDL_Surface *target, *signal;
+  struct arenaBlock signalPixels;
+  // chroma planes of the YCbCr simulation
+  struct arenaBlock chroma;
+  // the render in progress
+  const struct cardOptions *options;
+  SDL_Surface *surface;
+  int error;
+};
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static inline int saturatei(int a, const int min, const int max)
+{
+  if (a < min) return min;
+  if (a > max) return max;
+  return a;
+}
+
+static void toYCbCr(SDL_PixelFormat *format, Uint32 rgb, Uint8 *y, Uint8 *cb, Uint8 *cr)
+{
+  Uint8 r8, g8, b8;
+  SDL_GetRGB(rgb, format, &r8, &g8, &b8);
+  int r = r8, g = g8, b = b8;
+  *y  = (1081344 + 11966*r + 40254*g + 4064*b)>>16;
+  *cb = (8421376 + -6596*r + -22189*g + 28784*b)>>16;
+  *cr = (8421376 + 28784*r + -26145*g + -2639*b)>>16;
+}
+
+static Uint32 mapYCbCr(SDL_PixelFormat *format, int y, int cb, int cr)
+{
+  y  -= 16;
+  cb -= 128;
+  cr -= 128;
+  return SDL_MapRGB(
+    format,
+    saturatei((32768 + 76309*y + 120171*cr)>>16, 0, 255),
+    saturatei((32768 + 74606*y + -13975*cb + -34925*cr)>>16, 0, 255),
+    saturatei((32768 + 74606*y + 138438*cb)>>16, 0, 255)
+  );
+}
+
+static inline void fillRect(struct card *card, int x, int y, int w, int h, Uint32 color)
+{
+  paintRect(card->paint, x, y, w, h, color);
+  if(card->deep) deepInvalidate(card->deep, x, y, w, h);
+}
+
+static void rasterRect(struct card *card, int x, int y, int w, int h, Uint32 color1, Uint32 color2)
+{
+  // an empty size wraps around in SDL_Rect and fills to the edge
+  if (w <= 0 || h <= 0) {
+    fillRect(card, x, y, w, h, color1);
+    return;
+  }
+  paintChecker(card->paint, x, y, w, h, color1, color2);
+  if(card->deep) deepInvalidate(card->deep, x, y, w, h);
+}
+
+// Text is blended over what is below it, so that has to be painted
+// first.
+static void text(struct card *card, int size, int outline, int x, int y, const char *s, SDL_Color color)
+{
+  int w, h;
+  textSize(card->text, size, outline, s, &w, &h);
+  paintFlush(card->paint, x, y, w, h);
+  if(!drawText(card->text, card->surface, size, outline, x, y, s, color)) card->error = CARD_NOMEM;
+}
+
+static void textShaded(struct card *card, int size, int x, int y, const char *s, SDL_Color fg, SDL_Color bg)
+{
+  SDL_Surface *surface = card->surface;
+  int w, h;
+  textSize(card->text, size, 0, s, &w, &h);
+  fillRect(card, x, y, w, h, SDL_MapRGB(surface->format, bg.r, bg.g, bg.b));
+  text(card, size, 0, x, y, s, fg);
+}
+
+static void hLineRect(struct card *card, int l, int x, int y, int w, int h, Uint32 color1, Uint32 color2)
+{
+  if (w > 0 && h > 0) {
+    paintLines(card->paint, x, y, w, l*(h/l), l, false, color1, color2);
+    if(card->deep) deepInvalidate(card->deep, x, y, w, l*(h/l));
+    return;
+  }
+  // an empty size wraps around in SDL_Rect, draw it like it always was
+  fillRect(card, x, y, w, l*(h/l), color1);
+  y += l;
+  h += y - 2*l;
+  for(; y <= h; y += 2*l) {
+    fillRect(card, x, y, w, l, color2);
+  }
+}
+
+static void vLineRect(struct card *card, int l, int x, int y, int w, int h, Uint32 color1, Uint32 color2)
+{
+  if (w > 0 && h > 0) {
+    paintLines(card->paint, x, y, l*(w/l), h, l, true, color1, color2);
+    if(card->deep) deepInvalidate(card->deep, x, y, l*(w/l), h);
+    return;
+  }
+  // an empty size wraps around in SDL_Rect, draw it like it always was
+  fillRect(card, x, y, l*(w/l), h, color1);
+  x += l;
+  w += x - 2*l;
+  for(; x <= w; x += 2*l) {
+    fillRect(card, x, y, l, h, color2);
+  }
+}
+
+static inline Uint16 gradient16(int start, int end, int i, int n)
+{
+  return start*257 + (Sint64)i * (end-start) * 257 / maxi(1, n-1);
+}
+
+static void gradientRGB(struct card *card, int x, int y, int w, int h, int startr, int startg, int startb, int endr, int endg, int endb)
+{
+  SDL_Surface *surface = card->surface;
+  if(w > h) {
+    int s = maxi(1, w / 256);
+    for(int i = 0; i < w-s; i += s) {
+      int r = startr + (i * (endr-startr))/(w-1);
+      int g = startg + (i * (endg-startg))/(w-1);
+      int b = startb + (i * (endb-startb))/(w-1);
+      fillRect(card, x+i, y, s, h, SDL_MapRGB(surface->format, r, g, b));
+    }
+    fillRect(card, x+w-s, y, s, h, SDL_MapRGB(surface->format, endr, endg, endb));
+  } else {
+    int s = maxi(1, h / 256);
+    for(int i = 0; i < h-s; i += s) {
+      int r = startr + (i * (endr-startr))/(h-1);
+      int g = startg + (i * (endg-startg))/(h-1);
+      int b = startb + (i * (endb-startb))/(h-1);
+      fillRect(card, x, y+i, w, s, SDL_MapRGB(surface->format, r, g, b));
+    }
+    fillRect(card, x, y+h-s, w, s, SDL_MapRGB(surface->format, endr, endg, endb));
+  }
+
+  // every pixel gets its own value at 16 bits
+  if(card->deep) {
+    if(w > h) {
+      for(int i = 0; i < w; ++i) {
+        deepFill(card->deep, x+i, y, 1, h,
+                 gradient16(startr, endr, i, w),
+                 gradient16(startg, endg, i, w),
+                 gradient16(startb, endb, i, w));
+      }
+    } else {
+      for(int i = 0; i < h; ++i) {
+        deepFill(card->deep, x, y+i, w, 1,
+                 gradient16(startr, endr, i, h),
+                 gradient16(startg, endg, i, h),
+                 gradient16(startb, endb, i, h));
+      }
+    }
+  }
+}
+
+static inline void borders(struct card *card, int size)
+{
+  SDL_Surface *surface = card->surface;
+  Uint32 black = SDL_MapRGB(surface->format, 0, 0, 0);
+  Uint32 white = SDL_MapRGB(surface->format, 255, 255, 255);
+  int w = surface->w;
+  int h = surface->h;
+
+  // top, bottom, left and right rasterbars
+  int border = 2*(size/3);
+  rasterRect(card, size, 0, w-2*size, border, white, black);
+  rasterRect(card, size, h-border, w-2*size, border, white, black);
+  rasterRect(card, 0, size, border, h-2*size, white, black);
+  rasterRect(card, w-border, size, border, h-2*size, white, black);
+
+  // top-left corner
+  fillRect(card, 0, 0, size-1, size-1, white);
+  fillRect(card, 0, 0, 1, 1, black);
+  fillRect(card, 1, 1, size/3-1, size/3-1, black);
+  fillRect(card, 2, 2, 2*(size/3)-2, 2*(size/3)-2, black);
+  fillRect(card, 3, 3, size-4, size-4, black);
+
+  // top-right corner
+  fillRect(card, w-size+1, 0, size-1, size-1, white);
+  fillRect(card, w-1, 0, 1, 1, black);
+  fillRect(card, w-size/3, 1, size/3-1, size/3-1, black);
+  fillRect(card, w-2*(size/3), 2, 2*(size/3)-2, 2*(size/3)-2, black);
+  fillRect(card, w-size+1, 3, size-4, size-4, black);
+
+  // bottom-left corner
+  fillRect(card, 0, h-size+1, size-1, size-1, white);
+  fillRect(card, 0, h-1, 1, 1, black);
+  fillRect(card, 1, h-size/3, size/3-1, size/3-1, black);
+  fillRect(card, 2, h-2*(size/3), 2*(size/3)-2, 2*(size/3)-2, black);
+  fillRect(card, 3, h-size+1, size-4, size-4, black);
+
+  // bottom-right corner
+  fillRect(card, w-size+1, h-size+1, size-1, size-1, white);
+  fillRect(card, w-1, h-1, 1, 1, black);
+  fillRect(card, w-size/3, h-size/3, size/3-1, size/3-1, black);
+  fillRect(card, w-2*(size/3), h-2*(size/3), 2*(size/3)-2, 2*(size/3)-2, black);
+  fillRect(card, w-size+1, h-size+1, size-4, size-4, black);
+}
+
+static inline void RGBGradients(struct card *card, int x, int y, int w, int h)
+{
+  int s = h/4;
+  gradientRGB(card, x, y, w, s, 255,0,0, 0,0,0);
+  y += s;
+  gradientRGB(card, x, y, w, s, 0,255,0, 0,0,0);
+  y += s;
+  gradientRGB(card, x, y, w, s, 0,0,255, 0,0,0);
+  y += s;
+  gradientRGB(card, x, y, w, h-3*s, 255,255,255, 0,0,0);
+}
+
+static inline void gammaTable(struct card *card, int x, int y, int w, int h)
+{
+  SDL_Surface *surface = card->surface;
+  Uint32 black = SDL_MapRGB(surface->format, 0, 0, 0);
+  Uint32 white = SDL_MapRGB(surface->format, 255, 255, 255);
+  SDL_Color blackColor = {0,0,0,0};
+  SDL_Color grayColor = {200,200,200,0};
+
+  w = surface->w;
+
+  int wb = w / (2*17+1);
+  x = (w - wb * (2*17+1))/2;
+  if ((x&1)) x -= 1;
+
+  int size = maxi(h/5, 8);
+  h -= textLineSkip(card->text, size);
+
+  for (int i = 0; ; ++i) {
+    rasterRect(card, x, y, wb, h, white, black);
+
+    if (i > 16) break;
+
+    x += wb;
+
+    double gamma = 1. + i/10.;
+    int shade = 255. * pow(0.5, 1./gamma);
+    Uint32 gray = SDL_MapRGB(surface->format, shade, shade, shade);
+
+    fillRect(card, x, y, wb, h, gray);
+    if(card->deep) {
+      Uint16 shade16 = 65535. * pow(0.5, 1./gamma) + 0.5;
+      deepFill(card->deep, x, y, wb, h, shade16, shade16, shade16);
+    }
+
+    char buf[10];
+    sprintf(buf, "%1.1f", gamma);
+    int tw, th;
+    textSize(card->text, size, 1, buf, &tw, &th);
+    text(card, size, 1, x + (wb - tw)/2, y+h-1, buf, blackColor);
+    textSize(card->text, size, 0, buf, &tw, &th);
+    text(card, size, 0, x + (wb - tw)/2, y+h, buf, grayColor);
+
+    x += wb;
+  }
+}
+
+static inline void imageInfo(struct card *card, int x, int y, int w, int h, const char *label)
+{
+  SDL_Surface *surface = card->surface;
+  int size = maxi(h/2, 8);
+  char buf[16];
+  sprintf(buf, "%d×%d", (int)surface->w, (int)surface->h);
+  SDL_Color blackColor = {0,0,0,0};
+  SDL_Color whiteColor = {255, 255, 255, 0};
+  int tw, th;
+  textSize(card->text, size, 0, buf, &tw, &th);
+  if(tw > 0) {
+    SDL_Rect rect = { x + (w - tw)/2, y + (h - th)/2, 0, 0 };
+    Uint32 black = SDL_MapRGB(surface->format, 0, 0, 0);
+    Uint32 white = SDL_MapRGB(surface->format, 255, 255, 255);
+    fillRect(card, rect.x-h/4, y, tw+h/2, h, white);
+    fillRect(card, rect.x-h/8, y+h/8, tw+h/4, h-h/4, black);
+    textShaded(card, size, rect.x, rect.y, buf, whiteColor, blackColor);
+  }
+
+  if (!*label)
+    return;
+
+  size = maxi(h/11, 6);
+  textSize(card->text, size, 0, label, &tw, &th);
+  textShaded(card, size, x + (w - tw) / 2,  y + h - h/8, label, blackColor, whiteColor);
+}
+
+static inline void BWLinesBar(struct card *card, int x, int y, int w, int h)
+{
+  SDL_Surface *surface = card->surface;
+  Uint32 black = SDL_MapRGB(surface->format, 0, 0, 0);
+  Uint32 white = SDL_MapRGB(surface->format, 255, 255, 255);
+  int s = w/8;
+  x += (w - 8*s)/2;
+  for(int l = 1; l <= 4; ++l) {
+    vLineRect(card, l, x, y, s, h/2, white, black);
+    vLineRect(card, l, x+1, y+h/2, s-1, h/2, white, black);
+    x += s;
+  }
+  for(int l = 4; l >= 1; --l) {
+    hLineRect(card, l, x, y, s/2, h, white, black);
+    hLineRect(card, l, x+s/2, y+1, s/2, h-1, white, black);
+    x += s;
+  }
+}
+
+static inline void colorRects(struct card *card, int x, int y, int w, int h)
+{
+  SDL_Surface *surface = card->surface;
+  Uint8 rgb[8][3] = {
+    {255, 255, 255}, // white
+    {255, 255, 0}, // yellow
+    {0,255, 255}, // cyan
+    {0, 255, 0}, // green
+    {255, 0, 255}, // magenta
+    {255, 0, 0}, // red
+    {0, 0, 255}, // blue
+    {0, 0, 0}, // black
+  };
+
+  Uint32 colors[8];
+  for(int i = 0; i < 8; ++i) {
+    colors[i] = SDL_MapRGB(surface->format, rgb[i][0], rgb[i][1], rgb[i][2]);
+  }
+
+  fillRect(card, 0, 0, surface->w, y+h, colors[0]);
+
+  int rw = w/8;
+  x += (w - 7*rw)/2;
+  for(int i = 1; i < 8; ++i) {
+    fillRect(card, x, y, rw, h, colors[i]);
+    x += rw;
+  }
+}
+
+static inline void circlePoints(struct card *card, int cx, int cy, int x, int y, int size, Uint32 color)
+{
+  if(x == 0) {
+    fillRect(card, cx, cy + y, size, size, color);
+    fillRect(card, cx, cy - y, size, size, color);
+    fillRect(card, cx + y, cy, size, size, color);
+    fillRect(card, cx - y, cy, size, size, color);
+  } else {
+    fillRect(card, cx + x, cy + y, size, size, color);
+    fillRect(card, cx - x, cy + y, size, size, color);
+    fillRect(card, cx + x, cy - y, size, size, color);
+    fillRect(card, cx - x, cy - y, size, size, color);
+    if(x < y) {
+      fillRect(card, cx + y, cy + x, size, size, color);
+      fillRect(card, cx - y, cy + x, size, size, color);
+      fillRect(card, cx + y, cy - x, size, size, color);
+      fillRect(card, cx - y, cy - x, size, size, color);
+    }
+  }
+}
+
+static void drawCircle(struct card *card, int cx, int cy, int radius, int size, Uint32 color)
+{
+  int x = 0, y = radius, p = (5-radius*4)/4;
+  circlePoints(card, cx, cy, x, y, size, color);
+  while(x < y) {
+    ++x;
+    if(p < 0) {
+      p += 2*x+1;
+    } else {
+      --y;
+      p += 2*(x-y)+1;
+    }
+    circlePoints(card, cx, cy, x, y, size, color);
+  }
+}
+
+
+static void subsampleRect(struct card *card, int x, int y, int w, int h, Uint32 color1, Uint32 color2, Uint32 color3)
+{
+  int w6 = w/6;
+  int h6 = h/6;
+  rasterRect(card, x, y, w, h, color1, color2);
+  vLineRect(card, 1, x+2*w6, y+w6, 3*w6, h6, color1, color2);
+  hLineRect(card, 1, x+w6, y+2*w6, w6, 3*h6, color1, color2);
+  fillRect(card, x+3*w6, y+3*h6, 2*w6, 2*h6, color3);
+}
+
+static void colorSubsampling(struct card *card, int x, int y, int w, int h)
+{
+  SDL_Surface *surface = card->surface;
+  int w8 = mini(h, w/12);
+  int m = (w - 12*w8)/2;
+
+  // horizontal lines
+  hLineRect(card, 1, x+0*w8, y, w8, h,
+            mapYCbCr(surface->format, 128,192,192),
+            mapYCbCr(surface->format, 128,64,64));
+
+  hLineRect(card, 1, x+1*w8, y, w8, h,
+            mapYCbCr(surface->format, 128,128,192),
+            mapYCbCr(surface->format, 128,128,64));
+
+  hLineRect(card, 1, x+2*w8, y, w8, h,
+            mapYCbCr(surface->format, 128,192,128),
+            mapYCbCr(surface->format, 128,64,128));
+
+  hLineRect(card, 1, x+3*w8, y, w8, h,
+            SDL_MapRGB(surface->format, 64,64,64),
+            SDL_MapRGB(surface->format, 192,192,192));
+
+  x += m;
+
+  // quick indicators
+  subsampleRect(card, x+4*w8, y, w8, h,
+                SDL_MapRGB(surface->format, 255,255,255),
+                SDL_MapRGB(surface->format, 0,0,0),
+                SDL_MapRGB(surface->format, 128,128,128));
+
+  subsampleRect(card, x+5*w8, y, w8, h,
+                SDL_MapRGB(surface->format, 255,0,0),
+                SDL_MapRGB(surface->format, 0,0,255),
+                SDL_MapRGB(surface->format, 128,0,128));
+
+  subsampleRect(card, x+6*w8, y, w8, h,
+                SDL_MapRGB(surface->format, 0,0,255),
+                SDL_MapRGB(surface->format, 0,255,0),
+                SDL_MapRGB(surface->format, 0,168,168));
+
+  subsampleRect(card, x+7*w8, y, w8, h,
+                SDL_MapRGB(surface->format, 0,255,0),
+                SDL_MapRGB(surface->format, 255,0,0),
+                SDL_MapRGB(surface->format, 155,155,0));
+
+  x += m;
+  // vertical lines
+  vLineRect(card, 1, x+8*w8, y, w8, h,
+            SDL_MapRGB(surface->format, 64,64,64),
+            SDL_MapRGB(surface->format, 192,192,192));
+
+  vLineRect(card, 1, x+9*w8, y, w8, h,
+            mapYCbCr(surface->format, 128,192,128),
+            mapYCbCr(surface->format, 128,64,128));
+
+  vLineRect(card, 1, x+10*w8, y, w8, h,
+            mapYCbCr(surface->format, 128,128,192),
+            mapYCbCr(surface->format, 128,128,64));
+
+  vLineRect(card, 1, x+11*w8, y, w8, h,
+            mapYCbCr(surface->format, 128,192,192),
+            mapYCbCr(surface->format, 128,64,64));
+}
+
+static inline void copyright(struct card *card)
+{
+  SDL_Surface *surface = card->surface;
+  int size = maxi(8, surface->w/120);
+  SDL_Color grayColor = {180,180,180,0};
+  SDL_Color blueColor = {0,0,255,0};
+  const char *text = " Copyright © 2009-2016 Väinö Helminen ";
+  int tw, th;
+  textSize(card->text, size, 0, text, &tw, &th);
+  textShaded(card, size, (surface->w - tw)/2, surface->h - th, text, blueColor, grayColor);
+
+  text = " http://vah.dy.fi/testcard/ ";
+  textSize(card->text, size, 0, text, &tw, &th);
+  textShaded(card, size, (surface->w - tw)/2, 0, text, blueColor, grayColor);
+}
+
+static inline void bigCircle(struct card *card)
+{
+  SDL_Surface *surface = card->surface;
+  int radius = 2*mini(surface->w, surface->h)/5;
+  int cx = surface->w/2-1, cy = surface->h/2-1;
+  Uint32 black = SDL_MapRGB(surface->format, 0,0,0);
+  Uint32 gray = SDL_MapRGB(surface->format, 180,180,180);
+  Uint32 white = SDL_MapRGB(surface->format, 255,255,255);
+  drawCircle(card, cx+1, cy+1, radius, 3, black);
+  drawCircle(card, cx-1, cy-1, radius, 3, white);
+  drawCircle(card, cx, cy, radius, 3, gray);
+}
+
+static inline void overscan(struct card *card)
+{
+  SDL_Surface *surface = card->surface;
+  int w = surface->w, h = surface->h;
+  int w5 = (w+10)/20, w10 = (w+5)/10, h5 = (h+10)/20, h10 = (h+5)/10;
+  Uint32 black = SDL_MapRGB(surface->format, 0, 0, 0);
+  Uint32 green = SDL_MapRGB(surface->format, 0, 255, 0);
+  Uint32 yellow = SDL_MapRGB(surface->format, 255, 255, 0);
+  SDL_Color blackColor = { 0,0,0,0 };
+  SDL_Color greenColor = {0,255,0,0};
+  SDL_Color yellowColor = {255,255,0,0};
+
+  // top-left 5%
+  fillRect(card, w5-1, h5-1, w5+1, 3, black);
+  fillRect(card, w5-1, h5-1, 3, h5+1, black);
+  fillRect(card, w5, h5, w5, 1, green);
+  fillRect(card, w5, h5, 1, h5, green);
+  // top-left 10%
+  fillRect(card, w10-1, h10-1, w5+1, 3, black);
+  fillRect(card, w10-1, h10-1, 3, h5+1, black);
+  fillRect(card, w10, h10, w5, 1, yellow);
+  fillRect(card, w10, h10, 1, h5, yellow);
+
+  // bottom-left 5%
+  fillRect(card, w5-1, h-h5-2, w5+1, 3, black);
+  fillRect(card, w5-1, h-2*h5, 3, h5+1, black);
+  fillRect(card, w5, h-h5-1, w5, 1, green);
+  fillRect(card, w5, h-2*h5, 1, h5, green);
+  // bottom-left 10%
+  fillRect(card, w10-1, h-h10-2, w5+1, 3, black);
+  fillRect(card, w10-1, h-h10-h5, 3, h5+1, black);
+  fillRect(card, w10, h-h10-1, w5, 1, yellow);
+  fillRect(card, w10, h-h10-h5, 1, h5, yellow);
+
+  // top-right 5%
+  fillRect(card, w-2*w5, h5-1, w5+1, 3, black);
+  fillRect(card, w-w5-2, h5-1, 3, h5+1, black);
+  fillRect(card, w-2*w5, h5, w5, 1, green);
+  fillRect(card, w-w5-1, h5, 1, h5, green);
+  // top-right 10%
+  fillRect(card, w-w10-w5, h10-1, w5+1, 3, black);
+  fillRect(card, w-w10-2, h10-1, 3, h5+1, black);
+  fillRect(card, w-w10-w5, h10, w5, 1, yellow);
+  fillRect(card, w-w10-1, h10, 1, h5, yellow);
+
+  // bottom-right 5%
+  fillRect(card, w-2*w5, h-h5-2, w5+1, 3, black);
+  fillRect(card, w-w5-2, h-2*h5, 3, h5+1, black);
+  fillRect(card, w-2*w5, h-h5-1, w5, 1, green);
+  fillRect(card, w-w5-1, h-2*h5, 1, h5, green);
+  // bottom-right 10%
+  fillRect(card, w-w10-w5, h-h10-2, w5+1, 3, black);
+  fillRect(card, w-w10-2, h-h10-h5, 3, h5+1, black);
+  fillRect(card, w-w10-w5, h-h10-1, w5, 1, yellow);
+  fillRect(card, w-w10-1, h-h10-h5, 1, h5, yellow);
+
+
+  int size = maxi(8, w/60);
+  int tw, th;
+  textSize(card->text, size, 1, "5%", &tw, &th);
+  text(card, size, 1, w-w5-2-tw, h5, "5%", blackColor);
+  textSize(card->text, size, 1, "10%", &tw, &th);
+  text(card, size, 1, w-w10-2-tw, h10, "10%", blackColor);
+  textSize(card->text, size, 0, "5%", &tw, &th);
+  text(card, size, 0, w-w5-3-tw, h5+1, "5%", greenColor);
+  textSize(card->text, size, 0, "10%", &tw, &th);
+  text(card, size, 0, w-w10-3-tw, h10+1, "10%", yellowColor);
+}
+
+static void blur422h(Uint8* const p, const int w, const int h)
+{
+  for(int j = 0; j < h; ++j) {
+    for(int i = 0; i < w; i += 2) {
+      Sint32 v = (p[w * j + i  ] +
+                  p[w * j + i+1]) / 2;
+      p[w * j + i  ] = v;
+      p[w * j + i+1] = v;
+    }
+  }
+}
+
+static void blur422v(Uint8* const p, const int w, const int h)
+{
+  for(int j = 0; j < h; j += 2) {
+    for(int i = 0; i < w; ++i) {
+      Sint32 v = (p[w * j     + i] +
+                  p[w * (j+1) + i]) / 2;
+      p[w * j     + i] = v;
+      p[w * (j+1) + i] = v;
+    }
+  }
+}
+
+static void blur420(Uint8* const p, const int w, const int h)
+{
+  for(int j = 0; j < h; j += 2) {
+    for(int i = 0; i < w; i += 2) {
+      Sint32 v = (p[w * j     + i  ] +
+                  p[w * j     + i+1] +
+                  p[w * (j+1) + i  ] +
+                  p[w * (j+1) + i+1]) / 4;
+      p[w * j     + i  ] = v;
+      p[w * j     + i+1] = v;
+      p[w * (j+1) + i  ] = v;
+      p[w * (j+1) + i+1] = v;
+    }
+  }
+}
+
+// Interlaced video subsamples chroma vertically within each field, so
+// the pairs are lines j and j+2. Lines left without a pair at the
+// bottom keep their own chroma.
+static void blur422vi(Uint8* const p, const int w, const int h)
+{
+  for(int j = 0; j + 2 < h; j += (j & 1) ? 3 : 1) {
+    for(int i = 0; i < w; ++i) {
+      Sint32 v = (p[w * j     + i] +
+                  p[w * (j+2) + i]) / 2;
+      p[w * j     + i] = v;
+      p[w * (j+2) + i] = v;
+    }
+  }
+}
+
+static void blur420i(Uint8* const p, const int w, const int h)
+{
+  for(int j = 0; j + 2 < h; j += (j & 1) ? 3 : 1) {
+    for(int i = 0; i + 1 < w; i += 2) {
+      Sint32 v = (p[w * j     + i  ] +
+                  p[w * j     + i+1] +
+                  p[w * (j+2) + i  ] +
+                  p[w * (j+2) + i+1]) / 4;
+      p[w * j     + i  ] = v;
+      p[w * j     + i+1] = v;
+      p[w * (j+2) + i  ] = v;
+      p[w * (j+2) + i+1] = v;
+    }
+  }
+}
+
+
+// Only the clip rectangle, chroma is paired from its top-left corner.
+// Returns false when out of memory.
+static bool simulateYCbCr(struct card *card, int mode, bool interlaced)
+{
+  SDL_Surface *surface = card->surface;
+  const SDL_Rect clip = surface->clip_rect;
+  // the blurs pair an odd last column or row with what follows it, so
+  // each plane is followed by a copy of its last row and the last
+  // pixel keeps its own chroma
+  const size_t size = (size_t)clip.w * clip.h, plane = size + clip.w + 1;
+  Uint8* const tmpCb = arenaGet(card->arena, &card->chroma, 2*plane, false);
+  if(!tmpCb) return false;
+  Uint8* const tmpCr = tmpCb + plane;
+
+  // rows are stepped in bytes, the pitch need not be whole pixels
+  Uint8 *const first = (Uint8 *)surface->pixels + clip.y * surface->pitch + 4 * clip.x;
+  Uint8 *cbp = tmpCb, *crp = tmpCr;
+  for(int j = 0; j < clip.h; ++j) {
+    Uint32 *pixels = (Uint32 *)(first + j * surface->pitch);
+    for(int i = 0; i < clip.w; ++i) {
+      Uint8 y;
+      toYCbCr(surface->format, *pixels, &y, cbp++, crp++);
+      *pixels++ = y;
+    }
+  }
+  if(size) {
+    memcpy(tmpCb + size, tmpCb + size - clip.w, clip.w);
+    memcpy(tmpCr + size, tmpCr + size - clip.w, clip.w);
+    tmpCb[size] = tmpCb[size + clip.w] = tmpCb[size - 1];
+    tmpCr[size] = tmpCr[size + clip.w] = tmpCr[size - 1];
+  }
+
+  switch(mode) {
+  case CARD_YCBCR_422H:
+    blur422h(tmpCb, clip.w, clip.h);
+    blur422h(tmpCr, clip.w, clip.h);
+    break;
+  case CARD_YCBCR_422V:
+    (interlaced ? blur422vi : blur422v)(tmpCb, clip.w, clip.h);
+    (interlaced ? blur422vi : blur422v)(tmpCr, clip.w, clip.h);
+    break;
+  case CARD_YCBCR_420:
+    (interlaced ? blur420i : blur420)(tmpCb, clip.w, clip.h);
+    (interlaced ? blur420i : blur420)(tmpCr, clip.w, clip.h);
+    break;
+  default:
+    break;
+  }
+
+  cbp = tmpCb;
+  crp = tmpCr;
+  for(int j = 0; j < clip.h; ++j) {
+    Uint32 *pixels = (Uint32 *)(first + j * surface->pitch);
+    for(int i = 0; i < clip.w; ++i) {
+      *pixels = mapYCbCr(surface->format, *pixels, *cbp++, *crp++);
+      ++pixels;
+    }
+  }
+  return true;
+}
+
+struct cardLayout cardLayout(int w, int h)
+{
+  struct cardLayout l;
+  l.x = maxi((w+10)/20, (h+10)/20);
+  l.w = w - 2*l.x;
+  l.m = h / 70;
+  int hh = h - 2*l.x - 4*l.m;
+  l.h = hh / 12;
+  l.y = l.x + (hh - 12*l.h)/2;
+  return l;
+}
+
+const char * const CARD_REGION_NAME[CARD_REGIONS] = {
+  "colorbars",
+  "subsampling",
+  "gamma",
+  "imageinfo",
+  "gap",
+  "gradients",
+  "lines",
+  "bottom",
+  "left",
+  "right",
+};
+
+// Where the rows of render() start on a card of height h, indexed by
+// CARD_REGION_*, and h after the last.
+static void rowStarts(const struct cardLayout *l, int h, int *start)
+{
+  start[CARD_REGION_COLORBARS]   = 0;
+  start[CARD_REGION_SUBSAMPLING] = l->y + 1*l->h + 1*l->m;
+  start[CARD_REGION_GAMMA]       = l->y + 3*l->h + 2*l->m;
+  start[CARD_REGION_IMAGEINFO]   = l->y + 5*l->h + 3*l->m;
+  start[CARD_REGION_GAP]         = l->y + 7*l->h + 3*l->m;
+  start[CARD_REGION_GRADIENTS]   = l->y + 8*l->h + 4*l->m;
+  start[CARD_REGION_LINES]       = l->y + 10*l->h + 5*l->m;
+  start[CARD_REGION_BOTTOM]      = l->y + 12*l->h + 5*l->m;
+  start[CARD_REGION_ROWS] = h;
+}
+
+void cardRegions(int w, int h, SDL_Rect *regions)
+{
+  struct cardLayout l = cardLayout(w, h);
+  int top[CARD_REGION_ROWS + 1];
+  rowStarts(&l, h, top);
+  // cards too small or too wide for the layout squeeze rows and
+  // columns down to nothing instead of letting them overlap
+  for(int i = 1; i < CARD_REGION_ROWS; ++i) {
+    top[i] = mini(maxi(top[i], top[i-1]), h);
+  }
+  int x0 = mini(l.x, w), x1 = maxi(x0, mini(l.x + l.w, w));
+  for(int i = 0; i < CARD_REGION_ROWS; ++i) {
+    SDL_Rect r = {x0, top[i], x1 - x0, top[i+1] - top[i]};
+    regions[i] = r;
+  }
+  SDL_Rect left = {0, 0, x0, h}, right = {x1, 0, w - x1, h};
+  regions[CARD_REGION_LEFT] = left;
+  regions[CARD_REGION_RIGHT] = right;
+}
+
+void cardLabel(const struct cardOptions *options, const char *mode, char *label)
+{
+  snprintf(label, CARD_LABEL, "%s", mode);
+  if(options->fields) {
+    size_t n = strlen(label);
+    snprintf(label + n, CARD_LABEL - n, "%s%s", *label ? ", " : "", FIELDS_NAME[options->fields]);
+  }
+  if(options->scaler) {
+    size_t n = strlen(label);
+    snprintf(label + n, CARD_LABEL - n, "%sScaled %g%% %s", *label ? ", " : "",
+             100*options->zoom, SCALE_NAME[options->scaler]);
+  }
+}
+
+SDL_Rect cardDrawFrameId(SDL_Surface *surface, Uint32 frame)
+{
+  SDL_Rect area = {0, 0, 0, 0};
+  struct frameIdLayout l;
+  if (!frameIdLayout(surface->w, surface->h, &l)) return area;
+
+  Uint8 cells[FRAMEID_CELLS];
+  frameIdEncode(frame, cells);
+  Uint32 black = SDL_MapRGB(surface->format, 0, 0, 0);
+  Uint32 white = SDL_MapRGB(surface->format, 255, 255, 255);
+  for (int i = 0; i < FRAMEID_CELLS; ++i) {
+    SDL_Rect r = {l.x + (i % FRAMEID_COLUMNS) * l.cell, l.y + (i / FRAMEID_COLUMNS) * l.cell, l.cell, l.cell};
+    SDL_FillRect(surface, &r, cells[i] ? white : black);
+  }
+  area.x = l.x;
+  area.y = l.y;
+  area.w = FRAMEID_COLUMNS * l.cell;
+  area.h = FRAMEID_ROWS * l.cell;
+  return area;
+}
+
+static void render(struct card *card)
+{
+  const struct cardOptions *o = card->options;
+  SDL_Surface *surface = card->surface;
+  Uint32 background = SDL_MapRGB(surface->format, 48, 48, 48);
+  struct cardLayout l = cardLayout(surface->w, surface->h);
+  int x = l.x, y = l.y, w = l.w, h = l.h;
+  int row[CARD_REGION_ROWS + 1];
+  rowStarts(&l, surface->h, row);
+  char label[CARD_LABEL];
+  cardLabel(o, o->mode != CARD_RGB ? CARD_MODE_NAME[o->mode] : "", label);
+  // the frame ID goes under the first block of the lines bar, which is
+  // made shorter to keep its patterns whole
+  int linesY = row[CARD_REGION_LINES], linesH = 2*h;
+  struct frameIdLayout f;
+  bool frameId = o->frameId && frameIdLayout(surface->w, surface->h, &f);
+  if(frameId) linesH = maxi(0, mini(linesH, (f.y - linesY - 2) & ~1));
+  if(card->deep) {
+    deepClear(card->deep);
+  }
+  paintBegin(card->paint, surface);
+  fillRect(card, 0, 0, surface->w, surface->h, background);
+  colorRects  (card, x, row[CARD_REGION_COLORBARS], w, y + h);
+  borders(card, x);
+  copyright(card);
+  colorSubsampling(card, x, row[CARD_REGION_SUBSAMPLING], w, 2*h);
+  imageInfo   (card, x, row[CARD_REGION_IMAGEINFO], w, 2*h, label);
+  BWLinesBar  (card, x, linesY, w, linesH);
+  bigCircle(card);
+  gammaTable  (card, x, row[CARD_REGION_GAMMA], w, 2*h);
+  RGBGradients(card, x, row[CARD_REGION_GRADIENTS], w, 2*h);
+  overscan(card);
+  if(frameId) {
+    paintFlush(card->paint, f.x, f.y, FRAMEID_COLUMNS*f.cell, FRAMEID_ROWS*f.cell);
+    cardDrawFrameId(surface, o->frame);
+    if(card->deep) deepInvalidate(card->deep, f.x, f.y, FRAMEID_COLUMNS*f.cell, FRAMEID_ROWS*f.cell);
+  }
+  if(!paintEnd(card->paint)) card->error = CARD_NOMEM;
+  if(card->deep && !deepDither(card->deep, surface, o->dither)) {
+    card->error = CARD_NOMEM;
+  }
+  if(o->mode != CARD_RGB && !simulateYCbCr(card, o->mode, o->fields != FIELDS_NONE)) {
+    card->error = CARD_NOMEM;
+  }
+  if(o->fields) {
+    simulateFields(surface, o->fields);
+  }
+  if(card->deep && (o->mode != CARD_RGB || o->fields || o->scaler)) {
+    // the simulation works on the 8-bit card only
+    deepClear(card->deep);
+  }
+}
+
+void cardDefaults(struct cardOptions *options)
+{
+  memset(options, 0, sizeof(*options));
+  options->mode = CARD_RGB;
+  options->fields = FIELDS_NONE;
+  options->scaler = SCALE_NONE;
+  options->zoom = 1.05;
+  options->dither = DITHER_NONE;
+  options->culling = true;
+}
+
+static struct card *failed(struct card *card, int reason, int *error)
+{
+  cardFree(card);
+  if(error) *error = reason;
+  return NULL;
+}
+
+struct card *cardCreate(const char *fontFile, int threads, int flags, int *error)
+{
+  struct card *card = calloc(1, sizeof(*card));
+  if(!card) return failed(NULL, CARD_NOMEM, error);
+  card->arena = arenaCreate(flags & CARD_HUGEPAGES);
+  if(!card->arena) return failed(card, CARD_NOMEM, error);
+  card->paint = paintCreate(card->arena);
+  card->pool = poolCreate(threads);
+  card->scale = card->pool ? scaleCreate(card->pool, card->arena) : NULL;
+  if(!card->paint || !card->scale) return failed(card, CARD_NOMEM, error);
+  card->text = textCreate(fontFile, card->arena);
+  if(!card->text) return failed(card, fontFile ? CARD_FONT : CARD_NOMEM, error);
+  if(error) *error = CARD_OK;
+  return card;
+}
+
+void cardFree(struct card *card)
+{
+  if(!card) return;
+  textFree(card->text);
+  paintFree(card->paint);
+  scaleFree(card->scale);
+  poolFree(card->pool);
+  deepFree(card->deepStore);
+  SDL_FreeSurface(card->target);
+  SDL_FreeSurface(card->signal);
+  arenaFree(card->arena);
+  free(card);
+}
+
+// A card sized surface over the buffer whose clip rectangle is the
+// region in it, the pixel pointer is shifted so that the clip
+// rectangle lands on the buffer.
+static SDL_Surface *target(struct card *card, const struct cardBuffer *b, int x, int y, int w, int h)
+{
+  SDL_Surface *s = card->target;
+  if(!s || s->w != b->width || s->h != b->height || s->pitch != b->pitch ||
+     s->format->Rmask != b->rmask || s->format->Gmask != b->gmask || s->format->Bmask != b->bmask) {
+    SDL_FreeSurface(s);
+    s = card->target = SDL_CreateRGBSurfaceFrom(b->pixels, b->width, b->height, 32, b->pitch,
+                                                b->rmask, b->gmask, b->bmask, 0);
+    if(!s) return NULL;
+    arenaNote(card->arena);
+  }
+  s->pixels = (void *)((uintptr_t)b->pixels - (uintptr_t)y * b->pitch - (uintptr_t)x * 4);
+  SDL_Rect clip = {x, y, w, h};
+  SDL_SetClipRect(s, &clip);
+  return s;
+}
+
+int cardRender(struct card *card, const struct cardOptions *o, const struct cardBuffer *buffer)
+{
+  int x = buffer->x, y = buffer->y, w = buffer->w, h = buffer->h;
+  if(w <= 0 || h <= 0) {
+    x = y = 0;
+    w = buffer->width;
+    h = buffer->height;
+  }
+  if(!buffer->pixels || buffer->width <= 0 || buffer->height <= 0 ||
+     buffer->width > CARD_MAX || buffer->height > CARD_MAX ||
+     x < 0 || y < 0 || x + w > buffer->width || y + h > buffer->height || buffer->pitch < 4*w ||
+     o->mode < 0 || o->mode >= CARD_MODES || o->fields < 0 || o->fields >= FIELDS_METHODS ||
+     o->scaler < 0 || o->scaler >= SCALE_KERNELS) {
+    return CARD_BUFFER;
+  }
+  bool whole = w == buffer->width && h == buffer->height;
+  if(!whole && (o->scaler || o->deep || o->dither)) return CARD_BUFFER;
+
+  // the buffers were sized for another card, start over
+  if(buffer->width != card->width || buffer->height != card->height) {
+    deepFree(card->deepStore);
+    card->deep = card->deepStore = NULL;
+    SDL_FreeSurface(card->target);
+    SDL_FreeSurface(card->signal);
+    card->target = card->signal = NULL;
+    arenaReset(card->arena);
+    card->width = buffer->width;
+    card->height = buffer->height;
+  }
+
+  SDL_Surface *surface = target(card, buffer, x, y, w, h);
+  if(!surface) return CARD_NOMEM;
+  if(o->scaler) {
+    int sw = o->signalWidth > 0 ? o->signalWidth : buffer->width;
+    int sh = o->signalHeight > 0 ? o->signalHeight : buffer->height;
+    SDL_Surface *s = card->signal;
+    if(!s || s->w != sw || s->h != sh || s->format->Rmask != buffer->rmask ||
+       s->format->Gmask != buffer->gmask || s->format->Bmask != buffer->bmask) {
+      SDL_FreeSurface(s);
+      card->signal = NULL;
+      void *pixels = arenaGet(card->arena, &card->signalPixels, (size_t)sw * sh * 4, false);
+      if(!pixels) return CARD_NOMEM;
+      s = card->signal = SDL_CreateRGBSurfaceFrom(pixels, sw, sh, 32, sw * 4,
+                                                  buffer->rmask, buffer->gmask, buffer->bmask, 0);
+      if(!s) return CARD_NOMEM;
+      arenaNote(card->arena);
+    }
+    surface = s;
+  }
+  card->deep = NULL;
+  if(o->deep || o->dither) {
+    struct deep *d = card->deepStore;
+    if(!d || deepWidth(d) != surface->w || deepHeight(d) != surface->h) {
+      deepFree(d);
+      d = card->deepStore = deepCreate(surface->w, surface->h, card->arena);
+      if(!d) return CARD_NOMEM;
+    }
+    card->deep = d;
+  }
+
+  paintSetCulling(card->paint, o->culling);
+  paintSetCounting(card->paint, o->overdraw);
+  card->options = o;
+  card->surface = surface;
+  card->error = CARD_OK;
+  render(card);
+  if(o->scaler && !card->error && !scaleSurface(card->scale, card->target, surface, o->zoom, o->scaler)) {
+    card->error = CARD_NOMEM;
+  }
+  card->options = NULL;
+  card->surface = NULL;
+  return card->error;
+}
+
+const char *cardError(int error)
+{
+  switch(error) {
+  case CARD_OK:
+    return "Success";
+  case CARD_NOMEM:
+    return "Out of memory";
+  case CARD_FONT:
+    return "Can not open the font";
+  case CARD_BUFFER:
+    return "Buffer does not fit the card or the options";
+  default:
+    return "Unknown error";
+  }
+}
+
+struct text *cardText(struct card *card)
+{
+  return card->text;
+}
+
+struct deep *cardDeep(struct card *card)
+{
+  return card->deep;
+}
+
+struct paint *cardPaint(struct card *card)
+{
+  return card->paint;
+}
+
+void cardStats(const struct card *card, struct arenaStats *stats)
+{
+  arenaStats(card->arena, stats);
+}
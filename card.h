@@ -0,0 +1,164 @@
+/*
+ * Test Card - Renderer library
+ *
+ * Renders the card into a 32 bits per pixel buffer of the caller, with
+ * any pitch and channel order, so that other programs can link to
+ * libtestcard and make cards without a screen. Everything rendering
+ * needs lives in a context: the fonts, the rectangle painter, the
+ * 16-bit target, the scratch buffers of the simulations and a pool of
+ * threads for the scaler. Its buffers come from an arena, see arena.h,
+ * so rendering again at the same size allocates nothing; they are
+ * released when the card size changes. Contexts share nothing that is written
+ * while rendering, so any number of threads can render at the same
+ * time without locking each other, one context each. Failures are
+ * returned as CARD_* codes and nothing exits.
+ *
+ * SDL_ttf is not thread safe, so contexts with a font file have to be
+ * created and freed by one thread at a time. They open font sizes while
+ * rendering too, under a lock shared by every context, so rendering
+ * with them in parallel is safe but waits whenever a new size is
+ * opened.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_CARD_H
+#define TESTCARD_CARD_H
+
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "arena.h"
+#include "deep.h"
+#include "fields.h"
+#include "font.h"
+#include "paint.h"
+#include "scale.h"
+
+// Results
+#define CARD_OK     0
+#define CARD_NOMEM  1
+#define CARD_FONT   2
+#define CARD_BUFFER 3
+
+// Chroma subsampling simulated on the card
+#define CARD_RGB        0
+#define CARD_YCBCR_444  1
+#define CARD_YCBCR_422H 2
+#define CARD_YCBCR_422V 3
+#define CARD_YCBCR_420  4
+#define CARD_MODES      5
+
+// Mode names for messages and file names, indexed by CARD_*.
+extern const char * const CARD_MODE_NAME[CARD_MODES];
+
+// cardCreate() flags: back big buffers with huge pages
+#define CARD_HUGEPAGES 1
+
+// Cards can not be bigger than what SDL_Rect can address
+#define CARD_MAX 32767
+
+// The rows of the card from the top, each with the margin under it,
+// followed by the borders on the left and right. Together they cover
+// the card. The gap between the image info and the gradients is left
+// empty, e.g. for an animated frame counter.
+#define CARD_REGION_COLORBARS   0
+#define CARD_REGION_SUBSAMPLING 1
+#define CARD_REGION_GAMMA       2
+#define CARD_REGION_IMAGEINFO   3
+#define CARD_REGION_GAP         4
+#define CARD_REGION_GRADIENTS   5
+#define CARD_REGION_LINES       6
+#define CARD_REGION_BOTTOM      7
+#define CARD_REGION_LEFT        8
+#define CARD_REGION_RIGHT       9
+#define CARD_REGION_ROWS 8
+#define CARD_REGIONS     10
+
+// Region names without spaces, indexed like cardRegions().
+extern const char * const CARD_REGION_NAME[CARD_REGIONS];
+
+// Room for anything cardLabel() writes.
+#define CARD_LABEL 96
+
+struct cardOptions {
+  // CARD_RGB or one of the CARD_YCBCR_* modes
+  int mode;
+  // FIELDS_* deinterlacer simulated on top of the chroma mode
+  int fields;
+  // SCALE_* display scaler, the card is rendered at the signal size,
+  // the output size when 0, and scaled by zoom to fill the output
+  int scaler;
+  double zoom;
+  int signalWidth, signalHeight;
+  // DITHER_* method for the gradients and gamma table
+  int dither;
+  // keep the 16-bit copy of the gradients and gamma table, see cardDeep()
+  bool deep;
+  // the frame number as a code in the bottom-left corner
+  bool frameId;
+  Uint32 frame;
+  // skip what is covered, see paint.h, and count the writes to pixels
+  bool culling;
+  bool overdraw;
+};
+
+// Where to render. The buffer holds rows of pitch bytes of the part x,
+// y, w, h of a width by height card, all of it when w or h is 0.
+struct cardBuffer {
+  void *pixels;
+  int pitch;
+  Uint32 rmask, gmask, bmask;
+  int width, height;
+  int x, y, w, h;
+};
+
+// The card is laid out in rows of height h separated by margins of m
+// pixels, starting at (x, y) and w wide.
+struct cardLayout {
+  int x, y, w, h, m;
+};
+
+struct card;
+
+// Plain RGB with culling and the 105% overscan zoom of the scaler.
+void cardDefaults(struct cardOptions *options);
+
+// A context drawing text with the given TrueType font, or the built-in
+// one when NULL, and scaling on threads threads, 0 for one per CPU.
+// flags are CARD_* flags or 0. Returns NULL and the reason in *error on
+// failure.
+struct card *cardCreate(const char *fontFile, int threads, int flags, int *error);
+void cardFree(struct card *card);
+
+// Render a card. Scaling, dithering and keeping the 16-bit copy need
+// the whole card in the buffer.
+int cardRender(struct card *card, const struct cardOptions *options, const struct cardBuffer *buffer);
+
+// Message for a CARD_* result.
+const char *cardError(int error);
+
+struct cardLayout cardLayout(int w, int h);
+
+// The CARD_REGIONS regions of a w by h card, e.g. for telling which
+// part of it changed.
+void cardRegions(int w, int h, SDL_Rect *regions);
+
+// The simulations of the options after the given mode name, e.g.
+// "YCbCr 4:2:0, Interlaced bob", at most CARD_LABEL bytes.
+void cardLabel(const struct cardOptions *options, const char *mode, char *label);
+
+// Draw the code of the frame number, see frameid.h. Returns the area
+// drawn, empty if the surface is too small for it.
+SDL_Rect cardDrawFrameId(SDL_Surface *surface, Uint32 frame);
+
+// The fonts of the context, the 16-bit copy of the last render if it
+// was kept and the painter with the overdraw counts.
+struct text *cardText(struct card *card);
+struct deep *cardDeep(struct card *card);
+struct paint *cardPaint(struct card *card);
+
+// What the context has allocated so far and holds now.
+void cardStats(const struct card *card, struct arenaStats *stats);
+
+#endif
@@ -0,0 +1,733 @@
+/*
+ * Test Card - 16 bits per channel render target
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <zlib.h>
+#include <SDL.h>
+#if defined(__SSE2__) && SDL_BYTEORDER == SDL_LIL_ENDIAN
+#define DEEP_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "deep.h"
+
+struct deep {
+  int w, h;
+  struct arena *arena;
+  Uint16 *r, *g, *b;
+  Uint8 *valid;
+  // scratch rows for saving and dithering
+  Uint16 *rows;
+  struct arenaBlock planes, validBlock, rowsBlock;
+};
+
+#define NOISE 64
+
+// made by the first render that needs it, the state is 0 until then,
+// 1 while it is being made and 2 once it is ready
+static Uint8 blueNoise[NOISE * NOISE];
+static int blueNoiseState;
+
+static const Uint8 bayer[8][8] = {
+  { 0, 32,  8, 40,  2, 34, 10, 42},
+  {48, 16, 56, 24, 50, 18, 58, 26},
+  {12, 44,  4, 36, 14, 46,  6, 38},
+  {60, 28, 52, 20, 62, 30, 54, 22},
+  { 3, 35, 11, 43,  1, 33,  9, 41},
+  {51, 19, 59, 27, 49, 17, 57, 25},
+  {15, 47,  7, 39, 13, 45,  5, 37},
+  {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+// 16-bit RGB (shifted down to 15 bits) to 10-bit BT.709 limited range
+// YCbCr in 20-bit fixed point, see ycbcr.py. CR_G is rounded the other
+// way so that the chroma of grays is exactly zero.
+#define Y_R    5960
+#define Y_G   20049
+#define Y_B    2024
+#define CB_R  -3285
+#define CB_G -11051
+#define CB_B  14336
+#define CR_R  14336
+#define CR_G -13021
+#define CR_B  -1315
+#define Y_OFFSET ((64 << 20) + (1 << 19))
+#define C_OFFSET ((512 << 20) + (1 << 19))
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+struct deep *deepCreate(int w, int h, struct arena *arena)
+{
+  struct deep *deep = calloc(1, sizeof(struct deep));
+  if (!deep) return NULL;
+  arenaNote(arena);
+  size_t n = (size_t)w * h;
+  deep->w = w;
+  deep->h = h;
+  deep->arena = arena;
+  deep->r = arenaGet(arena, &deep->planes, 3 * n * sizeof(Uint16), false);
+  deep->valid = arenaGet(arena, &deep->validBlock, n, false);
+  deep->rows = arenaGet(arena, &deep->rowsBlock, 8 * (size_t)(w + 16) * sizeof(Uint16), false);
+  if (!deep->r || !deep->valid || !deep->rows) {
+    deepFree(deep);
+    return NULL;
+  }
+  memset(deep->valid, 0, n);
+  deep->g = deep->r + n;
+  deep->b = deep->g + n;
+  return deep;
+}
+
+void deepFree(struct deep *deep)
+{
+  if (!deep) return;
+  arenaRelease(deep->arena, &deep->planes);
+  arenaRelease(deep->arena, &deep->validBlock);
+  arenaRelease(deep->arena, &deep->rowsBlock);
+  free(deep);
+}
+
+int deepWidth(const struct deep *deep)
+{
+  return deep->w;
+}
+
+int deepHeight(const struct deep *deep)
+{
+  return deep->h;
+}
+
+void deepClear(struct deep *deep)
+{
+  memset(deep->valid, 0, (size_t)deep->w * deep->h);
+}
+
+static bool clip(struct deep *deep, int *x, int *y, int *w, int *h)
+{
+  int x0 = maxi(*x, 0), y0 = maxi(*y, 0);
+  int x1 = mini(*x + *w, deep->w), y1 = mini(*y + *h, deep->h);
+  *x = x0;
+  *y = y0;
+  *w = x1 - x0;
+  *h = y1 - y0;
+  return *w > 0 && *h > 0;
+}
+
+void deepFill(struct deep *deep, int x, int y, int w, int h, Uint16 r, Uint16 g, Uint16 b)
+{
+  if (!clip(deep, &x, &y, &w, &h)) return;
+  for (int j = y; j < y + h; ++j) {
+    size_t o = (size_t)j * deep->w + x;
+    for (int i = 0; i < w; ++i) {
+      deep->r[o + i] = r;
+      deep->g[o + i] = g;
+      deep->b[o + i] = b;
+    }
+    memset(deep->valid + o, 1, w);
+  }
+}
+
+void deepInvalidate(struct deep *deep, int x, int y, int w, int h)
+{
+  if (!clip(deep, &x, &y, &w, &h)) return;
+  for (int j = y; j < y + h; ++j) {
+    memset(deep->valid + (size_t)j * deep->w + x, 0, w);
+  }
+}
+
+// Void-and-cluster (Ulichney 1993) threshold matrix on a torus. Slow
+// but only done once.
+static bool makeBlueNoise(void)
+{
+  struct {
+    float kernel[NOISE * NOISE];
+    float energy[NOISE * NOISE];
+    float saved[NOISE * NOISE];
+    bool initial[NOISE * NOISE], pattern[NOISE * NOISE];
+    int rank[NOISE * NOISE];
+  } *work = malloc(sizeof(*work));
+  if (!work) return false;
+  float *kernel = work->kernel, *energy = work->energy, *saved = work->saved;
+  bool *initial = work->initial, *pattern = work->pattern;
+  int *rank = work->rank;
+  const int n = NOISE * NOISE;
+
+  for (int j = 0; j < NOISE; ++j) {
+    for (int i = 0; i < NOISE; ++i) {
+      int dx = mini(i, NOISE - i), dy = mini(j, NOISE - j);
+      kernel[j*NOISE + i] = expf(-(dx*dx + dy*dy) / (2 * 1.5f * 1.5f));
+    }
+  }
+
+#define TOGGLE(pat, p, on) do {                                         \
+    int px = (p) % NOISE, py = (p) / NOISE;                             \
+    float sign = (on) ? 1.f : -1.f;                                     \
+    (pat)[p] = (on);                                                    \
+    for (int q = 0; q < n; ++q) {                                       \
+      int dx = (q % NOISE - px) & (NOISE-1), dy = (q / NOISE - py) & (NOISE-1); \
+      energy[q] += sign * kernel[dy*NOISE + dx];                        \
+    }                                                                   \
+  } while (0)
+
+  // tightest cluster is the set pixel with the highest energy, the
+  // largest void the unset one with the lowest
+#define FIND(pat, set, cmp, out) do {                                   \
+    int best = -1;                                                      \
+    for (int q = 0; q < n; ++q) {                                       \
+      if (pat[q] == (set) && (best < 0 || energy[q] cmp energy[best])) best = q; \
+    }                                                                   \
+    out = best;                                                         \
+  } while (0)
+
+  // initial pattern of about 10% pseudo-random points, relaxed until
+  // removing the tightest cluster fills the largest void
+  memset(energy, 0, sizeof(work->energy));
+  memset(initial, 0, sizeof(work->initial));
+  Uint32 seed = 1;
+  int ones = 0;
+  while (ones < n / 10) {
+    seed = seed * 1103515245 + 12345;
+    int p = (seed >> 8) % n;
+    if (!initial[p]) {
+      TOGGLE(initial, p, true);
+      ++ones;
+    }
+  }
+  for (int k = 0; k < n; ++k) {
+    int cluster, hole;
+    FIND(initial, true, >, cluster);
+    TOGGLE(initial, cluster, false);
+    FIND(initial, false, <, hole);
+    TOGGLE(initial, hole, true);
+    if (hole == cluster) break;
+  }
+
+  // rank the initial points by removing clusters
+  memcpy(saved, energy, sizeof(work->energy));
+  memcpy(pattern, initial, sizeof(work->pattern));
+  for (int r = ones - 1; r >= 0; --r) {
+    int cluster;
+    FIND(pattern, true, >, cluster);
+    TOGGLE(pattern, cluster, false);
+    rank[cluster] = r;
+  }
+
+  // and the rest by filling voids
+  memcpy(energy, saved, sizeof(work->energy));
+  memcpy(pattern, initial, sizeof(work->pattern));
+  for (int r = ones; r < n; ++r) {
+    int hole;
+    FIND(pattern, false, <, hole);
+    TOGGLE(pattern, hole, true);
+    rank[hole] = r;
+  }
+#undef TOGGLE
+#undef FIND
+
+  for (int q = 0; q < n; ++q) {
+    blueNoise[q] = rank[q] * 256 / n;
+  }
+  free(work);
+  return true;
+}
+
+// Make the blue noise table unless it is there already. Threads that
+// need it while another one makes it wait for that one, this only
+// happens on the first render.
+static bool blueNoiseReady(void)
+{
+  int state = 0;
+  if (__atomic_compare_exchange_n(&blueNoiseState, &state, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    bool ok = makeBlueNoise();
+    __atomic_store_n(&blueNoiseState, ok ? 2 : 0, __ATOMIC_RELEASE);
+    return ok;
+  }
+  while (state == 1) {
+    SDL_Delay(1);
+    state = __atomic_load_n(&blueNoiseState, __ATOMIC_ACQUIRE);
+  }
+  return state == 2 || blueNoiseReady();
+}
+
+// Dither 16-bit values down to 8 bits and compose them into pixels
+// where valid is set. Exact 8-bit values (v = 257 * k) come out as k
+// regardless of the threshold t, which is in [0, 255].
+static void ditherRow(Uint32 *dst, const Uint16 *r, const Uint16 *g, const Uint16 *b,
+                      const Uint8 *valid, const Uint16 *t, int n, const SDL_PixelFormat *f)
+{
+  int i = 0;
+#ifdef DEEP_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i rs = _mm_cvtsi32_si128(f->Rshift);
+  const __m128i gs = _mm_cvtsi32_si128(f->Gshift);
+  const __m128i bs = _mm_cvtsi32_si128(f->Bshift);
+  for (; i + 8 <= n; i += 8) {
+    Uint64 v;
+    memcpy(&v, valid + i, 8);
+    if (!v) continue;
+    __m128i th = _mm_loadu_si128((const __m128i *)(t + i));
+    __m128i c[3];
+    const Uint16 *src[3] = {r, g, b};
+    for (int k = 0; k < 3; ++k) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(src[k] + i));
+      x = _mm_sub_epi16(x, _mm_srli_epi16(x, 8));
+      c[k] = _mm_srli_epi16(_mm_adds_epu16(x, th), 8);
+    }
+    __m128i lo = _mm_or_si128(_mm_or_si128(_mm_sll_epi32(_mm_unpacklo_epi16(c[0], zero), rs),
+                                           _mm_sll_epi32(_mm_unpacklo_epi16(c[1], zero), gs)),
+                              _mm_sll_epi32(_mm_unpacklo_epi16(c[2], zero), bs));
+    __m128i hi = _mm_or_si128(_mm_or_si128(_mm_sll_epi32(_mm_unpackhi_epi16(c[0], zero), rs),
+                                           _mm_sll_epi32(_mm_unpackhi_epi16(c[1], zero), gs)),
+                              _mm_sll_epi32(_mm_unpackhi_epi16(c[2], zero), bs));
+    __m128i m = _mm_cmpgt_epi8(_mm_loadl_epi64((const __m128i *)(valid + i)), zero);
+    m = _mm_unpacklo_epi8(m, m);
+    __m128i mlo = _mm_unpacklo_epi16(m, m), mhi = _mm_unpackhi_epi16(m, m);
+    __m128i d0 = _mm_loadu_si128((const __m128i *)(dst + i));
+    __m128i d1 = _mm_loadu_si128((const __m128i *)(dst + i + 4));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_and_si128(mlo, lo), _mm_andnot_si128(mlo, d0)));
+    _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_or_si128(_mm_and_si128(mhi, hi), _mm_andnot_si128(mhi, d1)));
+  }
+#endif
+  for (; i < n; ++i) {
+    if (!valid[i]) continue;
+    Uint32 cr = ((r[i] - (r[i] >> 8)) + t[i]) >> 8;
+    Uint32 cg = ((g[i] - (g[i] >> 8)) + t[i]) >> 8;
+    Uint32 cb = ((b[i] - (b[i] >> 8)) + t[i]) >> 8;
+    dst[i] = cr << f->Rshift | cg << f->Gshift | cb << f->Bshift;
+  }
+}
+
+bool deepDither(struct deep *deep, SDL_Surface *surface, int method)
+{
+  if (method == DITHER_NONE) return true;
+  if (method == DITHER_BLUENOISE && !blueNoiseReady()) return false;
+
+  if(SDL_MUSTLOCK(surface)) {
+    if(SDL_LockSurface(surface) < 0 ) {
+      return false;
+    }
+  }
+
+  int w = mini(deep->w, surface->w), h = mini(deep->h, surface->h);
+  Uint16 *t = deep->rows;
+  for (int j = 0; j < h; ++j) {
+    for (int i = 0; i < w; ++i) {
+      t[i] = method == DITHER_ORDERED
+        ? bayer[j & 7][i & 7] * 4 + 2
+        : blueNoise[(j & (NOISE-1)) * NOISE + (i & (NOISE-1))];
+    }
+    size_t o = (size_t)j * deep->w;
+    Uint32 *row = (Uint32 *)((Uint8 *)surface->pixels + j * surface->pitch);
+    ditherRow(row, deep->r + o, deep->g + o, deep->b + o, deep->valid + o, t, w, surface->format);
+  }
+
+  if(SDL_MUSTLOCK(surface)) {
+    SDL_UnlockSurface(surface);
+  }
+  return true;
+}
+
+// One row of the card at 16 bits: deep pixels where there are any,
+// otherwise the surface expanded from 8 bits.
+static void mergeRow(struct deep *deep, SDL_Surface *surface, int j, Uint16 *r, Uint16 *g, Uint16 *b)
+{
+  const SDL_PixelFormat *f = surface->format;
+  const Uint32 *row = (const Uint32 *)((const Uint8 *)surface->pixels + j * surface->pitch);
+  size_t o = (size_t)j * deep->w;
+  for (int i = 0; i < deep->w; ++i) {
+    if (deep->valid[o + i]) {
+      r[i] = deep->r[o + i];
+      g[i] = deep->g[o + i];
+      b[i] = deep->b[o + i];
+    } else {
+      Uint32 p = row[i];
+      r[i] = (((p & f->Rmask) >> f->Rshift) << f->Rloss) * 257;
+      g[i] = (((p & f->Gmask) >> f->Gshift) << f->Gloss) * 257;
+      b[i] = (((p & f->Bmask) >> f->Bshift) << f->Bloss) * 257;
+    }
+  }
+}
+
+// Luma of n 16-bit pixels.
+static void toY10(const Uint16 *r, const Uint16 *g, const Uint16 *b, Uint16 *y, int n)
+{
+  int i = 0;
+#ifdef DEEP_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i crg = _mm_set1_epi32((Uint32)(Uint16)Y_G << 16 | (Uint16)Y_R);
+  const __m128i cb = _mm_set1_epi32(Y_B);
+  const __m128i offset = _mm_set1_epi32(Y_OFFSET);
+  for (; i + 8 <= n; i += 8) {
+    __m128i vr = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(r + i)), 1);
+    __m128i vg = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(g + i)), 1);
+    __m128i vb = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(b + i)), 1);
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(vr, vg), crg),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(vb, zero), cb));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(vr, vg), crg),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(vb, zero), cb));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, offset), 20);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, offset), 20);
+    _mm_storeu_si128((__m128i *)(y + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] = (Y_R * (r[i] >> 1) + Y_G * (g[i] >> 1) + Y_B * (b[i] >> 1) + Y_OFFSET) >> 20;
+  }
+}
+
+// Chroma of n pixels that have already been averaged down to 15 bits.
+static void toC10(const Uint16 *r, const Uint16 *g, const Uint16 *b, Uint16 *cb, Uint16 *cr, int n)
+{
+  int i = 0;
+#ifdef DEEP_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i cbrg = _mm_set1_epi32((Uint32)(Uint16)CB_G << 16 | (Uint16)CB_R);
+  const __m128i cbb = _mm_set1_epi32(CB_B);
+  const __m128i crrg = _mm_set1_epi32((Uint32)(Uint16)CR_G << 16 | (Uint16)CR_R);
+  const __m128i crb = _mm_set1_epi32((Uint16)CR_B);
+  const __m128i offset = _mm_set1_epi32(C_OFFSET);
+  for (; i + 8 <= n; i += 8) {
+    __m128i vr = _mm_loadu_si128((const __m128i *)(r + i));
+    __m128i vg = _mm_loadu_si128((const __m128i *)(g + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    __m128i rglo = _mm_unpacklo_epi16(vr, vg), rghi = _mm_unpackhi_epi16(vr, vg);
+    __m128i blo = _mm_unpacklo_epi16(vb, zero), bhi = _mm_unpackhi_epi16(vb, zero);
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(rglo, cbrg), _mm_madd_epi16(blo, cbb));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(rghi, cbrg), _mm_madd_epi16(bhi, cbb));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, offset), 20);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, offset), 20);
+    _mm_storeu_si128((__m128i *)(cb + i), _mm_packs_epi32(lo, hi));
+    lo = _mm_add_epi32(_mm_madd_epi16(rglo, crrg), _mm_madd_epi16(blo, crb));
+    hi = _mm_add_epi32(_mm_madd_epi16(rghi, crrg), _mm_madd_epi16(bhi, crb));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, offset), 20);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, offset), 20);
+    _mm_storeu_si128((__m128i *)(cr + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    cb[i] = (CB_R * r[i] + CB_G * g[i] + CB_B * b[i] + C_OFFSET) >> 20;
+    cr[i] = (CR_R * r[i] + CR_G * g[i] + CR_B * b[i] + C_OFFSET) >> 20;
+  }
+}
+
+// Average horizontal pairs of one or two rows of 16-bit values down
+// to 15 bits, the last pixel of an odd row is paired with itself.
+static void averageRow(const Uint16 *a0, const Uint16 *a1, Uint16 *out, int w)
+{
+  const int n = w / 2;
+  const int shift = a1 ? 3 : 2;
+  int i = 0;
+#ifdef DEEP_SSE2
+  const __m128i low = _mm_set1_epi32(0xffff);
+  for (; i + 8 <= n; i += 8) {
+    __m128i x0 = _mm_loadu_si128((const __m128i *)(a0 + 2*i));
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(a0 + 2*i + 8));
+    __m128i s0 = _mm_add_epi32(_mm_and_si128(x0, low), _mm_srli_epi32(x0, 16));
+    __m128i s1 = _mm_add_epi32(_mm_and_si128(x1, low), _mm_srli_epi32(x1, 16));
+    if (a1) {
+      x0 = _mm_loadu_si128((const __m128i *)(a1 + 2*i));
+      x1 = _mm_loadu_si128((const __m128i *)(a1 + 2*i + 8));
+      s0 = _mm_add_epi32(s0, _mm_add_epi32(_mm_and_si128(x0, low), _mm_srli_epi32(x0, 16)));
+      s1 = _mm_add_epi32(s1, _mm_add_epi32(_mm_and_si128(x1, low), _mm_srli_epi32(x1, 16)));
+      s0 = _mm_srli_epi32(s0, 3);
+      s1 = _mm_srli_epi32(s1, 3);
+    } else {
+      s0 = _mm_srli_epi32(s0, 2);
+      s1 = _mm_srli_epi32(s1, 2);
+    }
+    _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(s0, s1));
+  }
+#endif
+  for (; i < n; ++i) {
+    Uint32 s = a0[2*i] + a0[2*i+1];
+    if (a1) s += a1[2*i] + a1[2*i+1];
+    out[i] = s >> shift;
+  }
+  if (w & 1) {
+    Uint32 s = 2 * a0[w-1];
+    if (a1) s += 2 * a1[w-1];
+    out[n] = s >> shift;
+  }
+}
+
+static inline void put32(Uint8 *p, Uint32 v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+// Little-endian 16-bit samples with the 10 bits at the top.
+static void packP010(Uint8 *p, const Uint16 *v, int n)
+{
+  int i = 0;
+#ifdef DEEP_SSE2
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+    _mm_storeu_si128((__m128i *)(p + 2*i), _mm_slli_epi16(x, 6));
+  }
+#endif
+  for (; i < n; ++i) {
+    p[2*i] = v[i] << 6;
+    p[2*i+1] = v[i] >> 2;
+  }
+}
+
+// Six pixels of 4:2:2 in four little-endian words. The last group is
+// padded with the last pixel, the caller zeroes the rest of the row up
+// to a multiple of 48 pixels (128 bytes).
+static void packV210(Uint8 *p, const Uint16 *y, const Uint16 *cb, const Uint16 *cr, int w)
+{
+  const int cw = (w + 1) / 2;
+  int i = 0;
+#ifdef DEEP_SSE2
+  // The words are the samples in the order Cb Y Cr Y, three at a time,
+  // so the planes are interleaved into that order, widened to 32 bits
+  // and each word ORed together from the sample and the next two,
+  // shifted in from the neighbouring lanes. Words start at every third
+  // sample and are picked from there. Reads 8 Y and 4 of each chroma.
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= w; i += 6, p += 16) {
+    __m128i ys = _mm_loadu_si128((const __m128i *)(y + i));
+    __m128i cs = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(cb + i/2)),
+                                    _mm_loadl_epi64((const __m128i *)(cr + i/2)));
+    __m128i lo = _mm_unpacklo_epi16(cs, ys), hi = _mm_unpackhi_epi16(cs, ys);
+    // samples 0-3, 4-7 and 8-11
+    __m128i s0 = _mm_unpacklo_epi16(lo, zero);
+    __m128i s1 = _mm_unpackhi_epi16(lo, zero);
+    __m128i s2 = _mm_unpacklo_epi16(hi, zero);
+    __m128i t0 = _mm_or_si128(s0, _mm_or_si128(
+      _mm_slli_epi32(_mm_or_si128(_mm_srli_si128(s0, 4), _mm_slli_si128(s1, 12)), 10),
+      _mm_slli_epi32(_mm_or_si128(_mm_srli_si128(s0, 8), _mm_slli_si128(s1, 8)), 20)));
+    __m128i t1 = _mm_or_si128(s1, _mm_or_si128(
+      _mm_slli_epi32(_mm_or_si128(_mm_srli_si128(s1, 4), _mm_slli_si128(s2, 12)), 10),
+      _mm_slli_epi32(_mm_or_si128(_mm_srli_si128(s1, 8), _mm_slli_si128(s2, 8)), 20)));
+    __m128i t2 = _mm_or_si128(s2, _mm_or_si128(
+      _mm_slli_epi32(_mm_srli_si128(s2, 4), 10), _mm_slli_epi32(_mm_srli_si128(s2, 8), 20)));
+    // words 0 and 3 from t0, 6 from t1 and 9 from t2
+    __m128i w03 = _mm_shuffle_epi32(t0, _MM_SHUFFLE(3, 3, 3, 0));
+    __m128i w69 = _mm_unpacklo_epi32(_mm_srli_si128(t1, 8), _mm_srli_si128(t2, 4));
+    _mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi64(w03, w69));
+  }
+#endif
+  for (; i + 6 <= w; i += 6, p += 16) {
+    const int c = i / 2;
+    put32(p,      cb[c]   | y[i]   << 10 | cr[c]   << 20);
+    put32(p + 4,  y[i+1]  | cb[c+1] << 10 | y[i+2] << 20);
+    put32(p + 8,  cr[c+1] | y[i+3] << 10 | cb[c+2] << 20);
+    put32(p + 12, y[i+4]  | cr[c+2] << 10 | y[i+5] << 20);
+  }
+  if (i < w) {
+    Uint16 ys[6], cbs[3], crs[3];
+    for (int k = 0; k < 6; ++k) ys[k] = y[mini(i + k, w - 1)];
+    for (int k = 0; k < 3; ++k) {
+      cbs[k] = cb[mini(i/2 + k, cw - 1)];
+      crs[k] = cr[mini(i/2 + k, cw - 1)];
+    }
+    put32(p,      cbs[0] | ys[0] << 10 | crs[0] << 20);
+    put32(p + 4,  ys[1]  | cbs[1] << 10 | ys[2] << 20);
+    put32(p + 8,  crs[1] | ys[3] << 10 | cbs[2] << 20);
+    put32(p + 12, ys[4]  | crs[2] << 10 | ys[5] << 20);
+  }
+}
+
+static bool saveV210(struct deep *deep, SDL_Surface *surface, FILE *f)
+{
+  const int w = deep->w, cw = (w + 1) / 2;
+  const int stride = (w + 47) / 48 * 128;
+  Uint16 *r = deep->rows, *g = r + w, *b = g + w;
+  Uint16 *y = b + w, *cb = y + w, *cr = cb + cw;
+  Uint16 *ar = cr + cw, *ag = ar + cw, *ab = ag + cw;
+  Uint8 *line = calloc(stride + 16, 1);
+  if (!line) return false;
+
+  bool ok = true;
+  for (int j = 0; j < deep->h && ok; ++j) {
+    mergeRow(deep, surface, j, r, g, b);
+    toY10(r, g, b, y, w);
+    averageRow(r, NULL, ar, w);
+    averageRow(g, NULL, ag, w);
+    averageRow(b, NULL, ab, w);
+    toC10(ar, ag, ab, cb, cr, cw);
+    memset(line, 0, stride);
+    packV210(line, y, cb, cr, w);
+    ok = fwrite(line, stride, 1, f) == 1;
+  }
+  free(line);
+  return ok;
+}
+
+static bool saveP010(struct deep *deep, SDL_Surface *surface, FILE *f)
+{
+  const int w = deep->w, cw = (w + 1) / 2;
+  Uint16 *r = deep->rows, *g = r + w, *b = g + w;
+  Uint16 *y = b + w;
+  Uint8 *line = malloc(4 * (size_t)cw + 16);
+  if (!line) return false;
+
+  bool ok = true;
+  for (int j = 0; j < deep->h && ok; ++j) {
+    mergeRow(deep, surface, j, r, g, b);
+    toY10(r, g, b, y, w);
+    packP010(line, y, w);
+    ok = fwrite(line, 2 * w, 1, f) == 1;
+  }
+
+  // interleaved Cb Cr plane at half the height
+  Uint16 *r1 = b + w, *g1 = r1 + w, *b1 = g1 + w;
+  Uint16 *ar = b1 + w, *ag = ar + cw, *ab = ag + cw;
+  Uint16 *cb = ab + cw, *cr = r, *c = g;
+  for (int j = 0; j < deep->h && ok; j += 2) {
+    mergeRow(deep, surface, j, r1, g1, b1);
+    if (j + 1 < deep->h) {
+      mergeRow(deep, surface, j + 1, r, g, b);
+    } else {
+      mergeRow(deep, surface, j, r, g, b);
+    }
+    averageRow(r1, r, ar, w);
+    averageRow(g1, g, ag, w);
+    averageRow(b1, b, ab, w);
+    toC10(ar, ag, ab, cb, cr, cw);
+    for (int i = 0; i < cw; ++i) {
+      c[2*i] = cb[i];
+      c[2*i+1] = cr[i];
+    }
+    packP010(line, c, 2 * cw);
+    ok = fwrite(line, 4 * cw, 1, f) == 1;
+  }
+  free(line);
+  return ok;
+}
+
+static bool pngChunk(FILE *f, const char *type, const Uint8 *data, Uint32 size)
+{
+  Uint8 head[8] = {size >> 24, size >> 16, size >> 8, size, type[0], type[1], type[2], type[3]};
+  uLong crc = crc32(crc32(0, NULL, 0), head + 4, 4);
+  crc = crc32(crc, data, size);
+  Uint8 tail[4] = {crc >> 24, crc >> 16, crc >> 8, crc};
+  return fwrite(head, 8, 1, f) == 1 &&
+    (!size || fwrite(data, size, 1, f) == 1) &&
+    fwrite(tail, 4, 1, f) == 1;
+}
+
+static bool savePNG16(struct deep *deep, SDL_Surface *surface, FILE *f)
+{
+  const int w = deep->w;
+  const size_t rowSize = 1 + 6 * (size_t)w;
+  Uint16 *r = deep->rows, *g = r + w, *b = g + w;
+  Uint8 *row = malloc(2 * rowSize);
+  Uint8 *out = malloc(1 << 16);
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if (!row || !out || deflateInit(&z, Z_BEST_SPEED) != Z_OK) {
+    free(row);
+    free(out);
+    return false;
+  }
+  Uint8 *filtered = row + rowSize;
+
+  static const Uint8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  Uint8 ihdr[13] = {w >> 24, w >> 16, w >> 8, w,
+                    deep->h >> 24, deep->h >> 16, deep->h >> 8, deep->h,
+                    16, 2, 0, 0, 0};
+  bool ok = fwrite(signature, 8, 1, f) == 1 && pngChunk(f, "IHDR", ihdr, 13);
+
+  for (int j = 0; j <= deep->h && ok; ++j) {
+    if (j < deep->h) {
+      mergeRow(deep, surface, j, r, g, b);
+      for (int i = 0; i < w; ++i) {
+        Uint8 *p = row + 1 + 6*i;
+        p[0] = r[i] >> 8;
+        p[1] = r[i];
+        p[2] = g[i] >> 8;
+        p[3] = g[i];
+        p[4] = b[i] >> 8;
+        p[5] = b[i];
+      }
+      // sub filter, the gradients compress much better with it
+      filtered[0] = 1;
+      memcpy(filtered + 1, row + 1, 6);
+      for (size_t k = 7; k < rowSize; ++k) {
+        filtered[k] = row[k] - row[k - 6];
+      }
+      z.next_in = filtered;
+      z.avail_in = rowSize;
+    }
+    int flush = j < deep->h ? Z_NO_FLUSH : Z_FINISH;
+    int ret;
+    do {
+      z.next_out = out;
+      z.avail_out = 1 << 16;
+      ret = deflate(&z, flush);
+      Uint32 size = (1 << 16) - z.avail_out;
+      if (size) ok = ok && pngChunk(f, "IDAT", out, size);
+    } while (ok && (z.avail_in || (flush == Z_FINISH && ret != Z_STREAM_END)));
+  }
+  ok = ok && pngChunk(f, "IEND", NULL, 0);
+
+  deflateEnd(&z);
+  free(row);
+  free(out);
+  return ok;
+}
+
+bool deepSave(struct deep *deep, SDL_Surface *surface, int format, const char *fileName)
+{
+  if (surface->w != deep->w || surface->h != deep->h) {
+    fprintf(stderr, "%s: Card and deep target sizes differ\n", fileName);
+    return false;
+  }
+  FILE *f = fopen(fileName, "wb");
+  if (!f) {
+    perror(fileName);
+    return false;
+  }
+
+  if(SDL_MUSTLOCK(surface)) {
+    if(SDL_LockSurface(surface) < 0 ) {
+      fprintf(stderr, "SDL_LockSurface: %s\n", SDL_GetError());
+      fclose(f);
+      return false;
+    }
+  }
+
+  bool ok;
+  switch (format) {
+  case DEEP_V210:
+    ok = saveV210(deep, surface, f);
+    break;
+  case DEEP_P010:
+    ok = saveP010(deep, surface, f);
+    break;
+  default:
+    ok = savePNG16(deep, surface, f);
+    break;
+  }
+
+  if(SDL_MUSTLOCK(surface)) {
+    SDL_UnlockSurface(surface);
+  }
+
+  if (fclose(f) || !ok) {
+    fprintf(stderr, "%s: Write failed\n", fileName);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,56 @@
+/*
+ * Test Card - 16 bits per channel render target
+ *
+ * The gradients and the gamma table are also rendered at 16 bits per
+ * channel so that banding on 10-bit displays and SDI chains isn't
+ * hidden by the 8-bit surface. The deep target only holds the pixels
+ * those stages drew, everything else is taken from the surface. It
+ * can be saved as packed 10-bit v210 (4:2:2) or P010 (4:2:0) YCbCr
+ * in ITU-R BT.709 limited range or as a 16-bit RGB PNG, and dithered
+ * down to 8 bits onto the surface.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_DEEP_H
+#define TESTCARD_DEEP_H
+
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "arena.h"
+
+#define DITHER_NONE      0
+#define DITHER_ORDERED   1
+#define DITHER_BLUENOISE 2
+
+#define DEEP_V210  1
+#define DEEP_P010  2
+#define DEEP_PNG16 4
+
+struct deep;
+
+// A w by h target with its planes in arena, NULL when out of memory.
+struct deep *deepCreate(int w, int h, struct arena *arena);
+void deepFree(struct deep *deep);
+int deepWidth(const struct deep *deep);
+int deepHeight(const struct deep *deep);
+
+// Forget every deep pixel, e.g. before rendering a new card.
+void deepClear(struct deep *deep);
+
+// Fill a rectangle with a 16-bit color.
+void deepFill(struct deep *deep, int x, int y, int w, int h, Uint16 r, Uint16 g, Uint16 b);
+
+// Drop the deep pixels of a rectangle that was overdrawn in 8 bits.
+void deepInvalidate(struct deep *deep, int x, int y, int w, int h);
+
+// Replace the surface pixels that have deep values with those values
+// dithered down to 8 bits. Returns false when out of memory.
+bool deepDither(struct deep *deep, SDL_Surface *surface, int method);
+
+// Write the card in one of the DEEP_* formats. Returns false and
+// prints an error on failure.
+bool deepSave(struct deep *deep, SDL_Surface *surface, int format, const char *fileName);
+
+#endif
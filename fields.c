@@ -0,0 +1,102 @@
+/*
+ * Test Card - Interlaced video simulation
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fields.h"
+
+// Differences between a line and the average of its neighbours up to
+// COMB_LOW are kept as detail, from there on the line is blended
+// towards the average until it is replaced completely at COMB_LOW+32.
+#define COMB_LOW 16
+
+const char * const FIELDS_NAME[FIELDS_METHODS] = {
+  "",
+  "Interlaced weave",
+  "Interlaced bob",
+  "Interlaced adaptive",
+};
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+// Blend a line of n bytes from the other field towards the average of
+// the lines above and below it. The weight is in 1/128ths.
+static void adaptiveRow(Uint8 *p, const Uint8 *above, const Uint8 *below, int n)
+{
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i low = _mm_set1_epi8(COMB_LOW);
+  const __m128i full = _mm_set1_epi8(32);
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    __m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(above + i)),
+                             _mm_loadu_si128((const __m128i *)(below + i)));
+    __m128i d = _mm_or_si128(_mm_subs_epu8(v, a), _mm_subs_epu8(a, v));
+    __m128i w = _mm_min_epu8(_mm_subs_epu8(d, low), full);
+    __m128i out[2];
+    for (int k = 0; k < 2; ++k) {
+      __m128i v16 = k ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+      __m128i a16 = k ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+      __m128i w16 = _mm_slli_epi16(k ? _mm_unpackhi_epi8(w, zero) : _mm_unpacklo_epi8(w, zero), 2);
+      out[k] = _mm_add_epi16(v16, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(a16, v16), w16), 7));
+    }
+    _mm_storeu_si128((__m128i *)(p + i), _mm_packus_epi16(out[0], out[1]));
+  }
+#endif
+  for (; i < n; ++i) {
+    int a = (above[i] + below[i] + 1) >> 1;
+    int w = 4 * mini(maxi(abs(p[i] - a) - COMB_LOW, 0), 32);
+    p[i] += ((a - p[i]) * w) >> 7;
+  }
+}
+
+void simulateFields(SDL_Surface *surface, int method)
+{
+  // weaving the fields back together gives the frame they came from
+  if (method != FIELDS_BOB && method != FIELDS_ADAPTIVE) return;
+
+  if(SDL_MUSTLOCK(surface)) {
+    if(SDL_LockSurface(surface) < 0 ) {
+      fprintf(stderr, "SDL_LockSurface: %s\n", SDL_GetError());
+      return;
+    }
+  }
+
+  // only the bottom field lines change and they only depend on the top
+  // field lines, so one pass over the clip rectangle does it
+  const SDL_Rect *clip = &surface->clip_rect;
+  Uint8 *pixels = (Uint8 *)surface->pixels + 4 * clip->x;
+  int pitch = surface->pitch, n = 4 * clip->w, end = clip->y + clip->h;
+  for (int j = clip->y + 1 + (clip->y & 1); j < end; j += 2) {
+    Uint8 *row = pixels + j * pitch;
+    const Uint8 *above = row - pitch;
+    const Uint8 *below = j + 1 < end ? row + pitch : above;
+    if (method == FIELDS_BOB) {
+      memcpy(row, above, n);
+    } else {
+      adaptiveRow(row, above, below, n);
+    }
+  }
+
+  if(SDL_MUSTLOCK(surface)) {
+    SDL_UnlockSurface(surface);
+  }
+}
@@ -0,0 +1,42 @@
+/*
+ * Test Card - Interlaced video simulation
+ *
+ * Splits the card into a top field (even lines) and a bottom field
+ * (odd lines) like an interlaced 1080i chain does and puts the frame
+ * back together the way a deinterlacer in the sink would:
+ *
+ *   weave     the fields are interleaved as they are, perfect for a
+ *             still card but combs anything that moves
+ *   bob       only the top field is shown with every line doubled,
+ *             one pixel high details flicker or disappear
+ *   adaptive  the bottom field is kept where it agrees with the top
+ *             field and replaced by the average of the lines above and
+ *             below where it looks like combing, which is what motion
+ *             adaptive deinterlacers do and what blurs fine horizontal
+ *             lines even on a still card
+ *
+ * Chroma subsampling of interlaced video is done within each field,
+ * see simulateYCbCr() in card.c.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_FIELDS_H
+#define TESTCARD_FIELDS_H
+
+#include <SDL.h>
+
+#define FIELDS_NONE     0
+#define FIELDS_WEAVE    1
+#define FIELDS_BOB      2
+#define FIELDS_ADAPTIVE 3
+#define FIELDS_METHODS  4
+
+// Names for messages and file names, indexed by FIELDS_*.
+extern const char * const FIELDS_NAME[FIELDS_METHODS];
+
+// Deinterlace the clip rectangle of a 32 bits per pixel surface in
+// place. Lines are top or bottom field by their row in the surface.
+void simulateFields(SDL_Surface *surface, int method);
+
+#endif
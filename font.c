@@ -0,0 +1,421 @@
+/*
+ * Test Card - Text rendering
+ *
+ * The built-in font is a table of signed distance fields, one per
+ * glyph, where 128 is the outline of the glyph and every step of 127 /
+ * SDF_SPREAD is one atlas pixel further in or out. Text is first
+ * rasterized into an 8-bit coverage mask by sampling the fields at
+ * the requested size and then alpha blended onto the surface.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "font.h"
+
+struct sdfGlyph {
+  Uint16 code;
+  Sint16 advance;
+  Sint16 x, y;
+  Uint16 w, h;
+  Uint32 offset;
+};
+
+#include "vera_sdf.h"
+
+#define FONT_CACHE 8
+
+// SDL_ttf renders text into a new surface, so the labels of the card
+// are kept as rendered for the next time
+#define LABEL_CACHE  64
+#define LABEL_LENGTH 64
+
+// SDL_ttf opens every font with one FreeType library, which can only
+// open and close faces on one thread at a time. Made by the first text
+// object with a font file and destroyed by the last, which like
+// TTF_Init() and TTF_Quit() happens one thread at a time.
+static SDL_mutex *fontLock;
+static int fontUsers;
+
+struct text {
+  // NULL for the built-in atlas
+  char *fontFile;
+  struct {
+    int size;
+    TTF_Font *font;
+  } fontCache[FONT_CACHE];
+  int fontCacheNext;
+  struct {
+    int size, outline;
+    SDL_Color color;
+    char text[LABEL_LENGTH];
+    SDL_Surface *surface;
+    Uint32 used;
+  } labels[LABEL_CACHE];
+  Uint32 clock;
+
+  struct arena *arena;
+  struct arenaBlock mask;
+};
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+// a/b rounded towards positive infinity for b > 0
+static inline int ceilDiv(int a, int b)
+{
+  return a >= 0 ? (a + b - 1) / b : a / b;
+}
+
+// Decode the next code point of an UTF-8 string, anything that isn't
+// a one or two byte sequence becomes '?'.
+static int nextChar(const char **text)
+{
+  const unsigned char *p = (const unsigned char *)*text;
+  int c = *p++;
+  if (c >= 0x80) {
+    if ((c & 0xe0) == 0xc0 && (*p & 0xc0) == 0x80) {
+      c = ((c & 0x1f) << 6) | (*p++ & 0x3f);
+    } else {
+      while ((*p & 0xc0) == 0x80) ++p;
+      c = '?';
+    }
+  }
+  *text = (const char *)p;
+  return c;
+}
+
+static const struct sdfGlyph *sdfGlyph(int c)
+{
+  if (c >= 0x20 && c <= 0x7e) return &sdfGlyphs[c - 0x20];
+  if (c >= 0xa0 && c <= 0xff) return &sdfGlyphs[c - 0xa0 + 0x7f - 0x20];
+  return &sdfGlyphs['?' - 0x20];
+}
+
+static inline int sdfAscent(int size)
+{
+  return ceilDiv(SDF_ASCENT * size, SDF_EM);
+}
+
+static void sdfSize(int size, int outline, const char *text, int *w, int *h)
+{
+  Sint64 pen = 0;
+  while (*text) {
+    pen += ((Sint64)sdfGlyph(nextChar(&text))->advance * size << 16) / SDF_EM;
+  }
+  *w = (int)((pen + 0xffff) >> 16) + 2*outline;
+  *h = sdfAscent(size) - ceilDiv(SDF_DESCENT * size, SDF_EM) + 1 + 2*outline;
+}
+
+static inline int sdfTexel(const struct sdfGlyph *g, int u, int v)
+{
+  if (u < 0 || v < 0 || u >= g->w || v >= g->h) return 0;
+  return sdfAtlas[g->offset + v*g->w + u];
+}
+
+// Rasterize the part x0..x1, y0..y1 of text into the w*h coverage
+// mask. The outline grows the glyphs by the given number of pixels,
+// same as with SDL_ttf.
+static void sdfMask(Uint8 *mask, int size, int outline, const char *text, int w, int x0, int y0, int x1, int y1)
+{
+  for (int j = y0; j < y1; ++j) {
+    memset(mask + j*w + x0, 0, x1 - x0);
+  }
+
+  const float k = (float)size / SDF_EM;
+  const float a = SDF_DOWN * k;
+  const float scale = SDF_SPREAD * a / 127.f;
+  const int ascent = sdfAscent(size);
+
+  Sint64 pen = 0;
+  while (*text) {
+    const struct sdfGlyph *g = sdfGlyph(nextChar(&text));
+    const float gx = outline + pen / 65536.f + g->x * k;
+    const float gy = outline + ascent + (g->y - SDF_ASCENT) * k;
+    pen += ((Sint64)g->advance * size << 16) / SDF_EM;
+    if (!g->w) continue;
+
+    int i0 = maxi(x0, floorf(gx)), i1 = mini(x1, ceilf(gx + g->w * a));
+    int j0 = maxi(y0, floorf(gy)), j1 = mini(y1, ceilf(gy + g->h * a));
+    for (int j = j0; j < j1; ++j) {
+      float v = (j + 0.5f - gy) / a - 0.5f;
+      int vi = floorf(v);
+      float fv = v - vi;
+      Uint8 *m = mask + j*w;
+      for (int i = i0; i < i1; ++i) {
+        float u = (i + 0.5f - gx) / a - 0.5f;
+        int ui = floorf(u);
+        float fu = u - ui;
+        float s0 = sdfTexel(g, ui, vi) + fu * (sdfTexel(g, ui+1, vi) - sdfTexel(g, ui, vi));
+        float s1 = sdfTexel(g, ui, vi+1) + fu * (sdfTexel(g, ui+1, vi+1) - sdfTexel(g, ui, vi+1));
+        float d = (s0 + fv * (s1 - s0) - 128) * scale + outline + 0.5f;
+        if (d > 0) {
+          int c = d >= 1 ? 255 : (int)(d * 255 + 0.5f);
+          if (c > m[i]) m[i] = c;
+        }
+      }
+    }
+  }
+}
+
+// dst = (src*a + dst*(255-a)) / 255 rounded, for each byte of n
+// 32-bit pixels. The SSE2 version does four pixels at a time and
+// gives the exact same result.
+static void blendRow(Uint32 *dst, const Uint8 *alpha, int n, Uint32 color)
+{
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i c128 = _mm_set1_epi16(128);
+  const __m128i c255 = _mm_set1_epi16(255);
+  const __m128i src = _mm_set1_epi32(color);
+  const __m128i s = _mm_unpacklo_epi8(src, zero);
+  for (; i + 4 <= n; i += 4) {
+    Uint32 m;
+    memcpy(&m, alpha + i, 4);
+    if (!m) continue;
+    if (m == 0xffffffff) {
+      _mm_storeu_si128((__m128i *)(dst + i), src);
+      continue;
+    }
+    __m128i am = _mm_cvtsi32_si128(m);
+    am = _mm_unpacklo_epi8(am, am);
+    am = _mm_unpacklo_epi16(am, am);
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+    __m128i alo = _mm_unpacklo_epi8(am, zero);
+    __m128i ahi = _mm_unpackhi_epi8(am, zero);
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, alo),
+                                             _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(c255, alo))),
+                               c128);
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, ahi),
+                                             _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(c255, ahi))),
+                               c128);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    Uint32 a = alpha[i];
+    if (!a) continue;
+    Uint32 out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      Uint32 v = ((color >> shift) & 0xff) * a + ((dst[i] >> shift) & 0xff) * (255 - a) + 128;
+      out |= ((v + (v >> 8)) >> 8) << shift;
+    }
+    dst[i] = out;
+  }
+}
+
+// Blend the part i0..i1, j0..j1 of the surface covered by the w wide
+// mask at x, y.
+static bool blendMask(const Uint8 *mask, SDL_Surface *surface, int x, int y, int w, int i0, int j0, int i1, int j1, SDL_Color color)
+{
+  if(SDL_MUSTLOCK(surface)) {
+    if(SDL_LockSurface(surface) < 0 ) {
+      return false;
+    }
+  }
+
+  Uint32 c = SDL_MapRGB(surface->format, color.r, color.g, color.b);
+  for (int j = j0; j < j1; ++j) {
+    Uint32 *row = (Uint32 *)((Uint8 *)surface->pixels + j*surface->pitch);
+    blendRow(row + i0, mask + (j-y)*w + (i0-x), i1 - i0, c);
+  }
+
+  if(SDL_MUSTLOCK(surface)) {
+    SDL_UnlockSurface(surface);
+  }
+  return true;
+}
+
+static TTF_Font *openFont(struct text *t, int size)
+{
+  for (int i = 0; i < FONT_CACHE; ++i) {
+    if (t->fontCache[i].font && t->fontCache[i].size == size) {
+      return t->fontCache[i].font;
+    }
+  }
+  SDL_LockMutex(fontLock);
+  TTF_Font *font = TTF_OpenFont(t->fontFile, size);
+  int i = t->fontCacheNext % FONT_CACHE;
+  if (font && t->fontCache[i].font) {
+    TTF_CloseFont(t->fontCache[i].font);
+  }
+  SDL_UnlockMutex(fontLock);
+  if (!font) return NULL;
+  arenaNote(t->arena);
+  ++t->fontCacheNext;
+  t->fontCache[i].size = size;
+  t->fontCache[i].font = font;
+  return font;
+}
+
+// The label rendered with SDL_ttf, from the cache when it was drawn
+// before. Labels too long for the cache have to be freed by the caller.
+static SDL_Surface *renderLabel(struct text *t, TTF_Font *font, int size, int outline, const char *text, SDL_Color color)
+{
+  bool cached = strlen(text) < LABEL_LENGTH;
+  int oldest = 0;
+  for (int i = 0; cached && i < LABEL_CACHE; ++i) {
+    if (t->labels[i].surface && t->labels[i].size == size && t->labels[i].outline == outline &&
+        t->labels[i].color.r == color.r && t->labels[i].color.g == color.g && t->labels[i].color.b == color.b &&
+        !strcmp(t->labels[i].text, text)) {
+      t->labels[i].used = ++t->clock;
+      return t->labels[i].surface;
+    }
+    if (t->labels[i].used < t->labels[oldest].used) oldest = i;
+  }
+
+  TTF_SetFontOutline(font, outline);
+  SDL_Surface *rendered = TTF_RenderUTF8_Blended(font, text, color);
+  if (!rendered) return NULL;
+  arenaNote(t->arena);
+  if (cached) {
+    SDL_FreeSurface(t->labels[oldest].surface);
+    t->labels[oldest].size = size;
+    t->labels[oldest].outline = outline;
+    t->labels[oldest].color = color;
+    strcpy(t->labels[oldest].text, text);
+    t->labels[oldest].surface = rendered;
+    t->labels[oldest].used = ++t->clock;
+  }
+  return rendered;
+}
+
+struct text *textCreate(const char *fontFile, struct arena *arena)
+{
+  struct text *t = calloc(1, sizeof(*t));
+  if (!t) return NULL;
+  t->arena = arena;
+  if (!fontFile) return t;
+
+  t->fontFile = malloc(strlen(fontFile) + 1);
+  if (!t->fontFile) {
+    free(t);
+    return NULL;
+  }
+  strcpy(t->fontFile, fontFile);
+  // SDL_ttf counts these, the last textFree() shuts it down
+  if (!fontUsers) fontLock = SDL_CreateMutex();
+  if (!fontLock || TTF_Init()) {
+    if (!fontUsers && fontLock) {
+      SDL_DestroyMutex(fontLock);
+      fontLock = NULL;
+    }
+    free(t->fontFile);
+    free(t);
+    return NULL;
+  }
+  ++fontUsers;
+  // find out right away whether the font can be used
+  if (!openFont(t, 12)) {
+    textFree(t);
+    return NULL;
+  }
+  return t;
+}
+
+void textFree(struct text *t)
+{
+  if (!t) return;
+  if (t->fontFile) {
+    SDL_LockMutex(fontLock);
+    for (int i = 0; i < FONT_CACHE; ++i) {
+      if (t->fontCache[i].font) {
+        TTF_CloseFont(t->fontCache[i].font);
+      }
+    }
+    SDL_UnlockMutex(fontLock);
+    for (int i = 0; i < LABEL_CACHE; ++i) {
+      SDL_FreeSurface(t->labels[i].surface);
+    }
+    TTF_Quit();
+    if (!--fontUsers) {
+      SDL_DestroyMutex(fontLock);
+      fontLock = NULL;
+    }
+    free(t->fontFile);
+  }
+  arenaRelease(t->arena, &t->mask);
+  free(t);
+}
+
+void textSize(struct text *t, int size, int outline, const char *text, int *w, int *h)
+{
+  if (!t->fontFile) {
+    sdfSize(size, outline, text, w, h);
+    return;
+  }
+  *w = *h = 0;
+  TTF_Font *font = openFont(t, size);
+  if (font) {
+    TTF_SetFontOutline(font, outline);
+    TTF_SizeUTF8(font, text, w, h);
+  }
+}
+
+int textLineSkip(struct text *t, int size)
+{
+  if (!t->fontFile) {
+    return ceilDiv(SDF_LINESKIP * size, SDF_EM);
+  }
+  TTF_Font *font = openFont(t, size);
+  return font ? TTF_FontLineSkip(font) : 0;
+}
+
+bool drawText(struct text *t, SDL_Surface *surface, int size, int outline, int x, int y, const char *text, SDL_Color color)
+{
+  if (t->fontFile) {
+    TTF_Font *font = openFont(t, size);
+    if (!font) return false;
+    SDL_Surface *rendered = renderLabel(t, font, size, outline, text, color);
+    // nothing to draw is not an error
+    if (!rendered) return !*text;
+    SDL_Rect rect = {x, y, 0, 0};
+    SDL_BlitSurface(rendered, NULL, surface, &rect);
+    if (strlen(text) >= LABEL_LENGTH) SDL_FreeSurface(rendered);
+    return true;
+  }
+
+  int w, h;
+  sdfSize(size, outline, text, &w, &h);
+  if (w <= 0 || h <= 0) return true;
+
+  // only what is inside the clip rectangle gets rasterized
+  const SDL_Rect *clip = &surface->clip_rect;
+  int i0 = maxi(x, clip->x), i1 = mini(x + w, clip->x + clip->w);
+  int j0 = maxi(y, clip->y), j1 = mini(y + h, clip->y + clip->h);
+  if (i0 >= i1 || j0 >= j1) return true;
+
+  Uint8 *mask = arenaGet(t->arena, &t->mask, (size_t)w * h, false);
+  if (!mask) return false;
+  sdfMask(mask, size, outline, text, w, i0 - x, j0 - y, i1 - x, j1 - y);
+  return blendMask(mask, surface, x, y, w, i0, j0, i1, j1, color);
+}
+
+bool drawTextShaded(struct text *t, SDL_Surface *surface, int size, int x, int y, const char *text, SDL_Color fg, SDL_Color bg)
+{
+  int w, h;
+  textSize(t, size, 0, text, &w, &h);
+  SDL_Rect rect = {x, y, w, h};
+  SDL_FillRect(surface, &rect, SDL_MapRGB(surface->format, bg.r, bg.g, bg.b));
+  return drawText(t, surface, size, 0, x, y, text, fg);
+}
@@ -0,0 +1,54 @@
+/*
+ * Test Card - Text rendering
+ *
+ * Text is drawn from a signed distance field atlas of Bitstream Vera
+ * that is generated at build time (see tools/fontgen.c) and compiled
+ * into the program, so any size can be rendered without touching the
+ * file system. Giving textCreate() a font file switches to the much
+ * slower SDL_ttf path for using some other TrueType font.
+ *
+ * The fonts and the mask text is rasterized into belong to a text
+ * object, so threads drawing with objects of their own do not get in
+ * each other's way. The mask is kept in an arena and what SDL_ttf
+ * renders is cached, so drawing the same labels again allocates
+ * nothing. SDL_ttf itself is not thread safe though: objects
+ * with a font file must be created and freed by one thread at a time.
+ * The sizes they open while drawing are opened and closed under a
+ * process-wide lock, so drawing with them on several threads is fine.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_FONT_H
+#define TESTCARD_FONT_H
+
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "arena.h"
+
+struct text;
+
+// Draw text with the given TrueType font, or the built-in atlas when
+// NULL, with the buffers in arena. Returns NULL when out of memory or
+// the font can't be opened.
+struct text *textCreate(const char *fontFile, struct arena *arena);
+
+// Release fonts and buffers.
+void textFree(struct text *t);
+
+// Size of the box drawText() would fill for UTF-8 text at the given
+// point size and outline width.
+void textSize(struct text *t, int size, int outline, const char *text, int *w, int *h);
+
+// Distance between two lines of text at the given point size.
+int textLineSkip(struct text *t, int size);
+
+// Alpha blend UTF-8 text with its top-left corner at (x, y). Returns
+// false when out of memory.
+bool drawText(struct text *t, SDL_Surface *surface, int size, int outline, int x, int y, const char *text, SDL_Color color);
+
+// Like drawText() but fill the text box with a background color first.
+bool drawTextShaded(struct text *t, SDL_Surface *surface, int size, int x, int y, const char *text, SDL_Color fg, SDL_Color bg);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Test Card - Machine readable frame ID
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frameid.h"
+
+// white and black must differ by this much out of 255 to be read
+#define MIN_CONTRAST 48
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+// CRC-16/CCITT of the frame number in big-endian byte order
+static uint16_t crc16(uint32_t frame)
+{
+  uint16_t crc = 0xffff;
+  for (int i = 3; i >= 0; --i) {
+    crc ^= (uint16_t)((frame >> (8*i)) & 0xff) << 8;
+    for (int j = 0; j < 8; ++j) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+bool frameIdLayout(int w, int h, struct frameIdLayout *layout)
+{
+  // the same rounding as borders() and overscan()
+  int w5 = (w+10)/20, h5 = (h+10)/20, h10 = (h+5)/10;
+  int size = maxi(w5, h5);
+  int border = 2*(size/3);
+
+  // right of the 5% mark and the corner, below the 10% mark, above
+  // the 5% mark and the bottom rasterbar
+  int x0 = maxi(w5 + 3, size + 1), x1 = 2*w5;
+  int y0 = h - h10 + 3, y1 = mini(h - h5 - 3, h - border - 1);
+  x0 += x0 & 1;
+  y0 += y0 & 1;
+
+  int cell = mini((x1 - x0) / FRAMEID_COLUMNS, (y1 - y0) / FRAMEID_ROWS) & ~1;
+  if (cell < 2) return false;
+  layout->x = x0;
+  layout->y = y0;
+  layout->cell = cell;
+  return true;
+}
+
+void frameIdEncode(uint32_t frame, uint8_t cells[FRAMEID_CELLS])
+{
+  for (int i = 0; i < FRAMEID_COLUMNS; ++i) {
+    cells[i] = !(i & 1);
+  }
+  uint64_t bits = (uint64_t)frame << 16 | crc16(frame);
+  for (int i = 0; i < 48; ++i) {
+    cells[FRAMEID_COLUMNS + i] = (bits >> (47 - i)) & 1;
+  }
+}
+
+// Average of the middle half of a cell scaled to 8 bits.
+static int sampleCell(const struct frameIdLayout *layout, int index, const uint8_t *luma,
+                      int stride, int step, int depth)
+{
+  int x = layout->x + (index % FRAMEID_COLUMNS) * layout->cell;
+  int y = layout->y + (index / FRAMEID_COLUMNS) * layout->cell;
+  int m = layout->cell / 4, n = maxi(1, layout->cell / 2);
+  int sum = 0;
+  for (int j = y + m; j < y + m + n; ++j) {
+    const uint8_t *p = luma + (long)j * stride + (long)(x + m) * step;
+    for (int i = 0; i < n; ++i, p += step) {
+      sum += depth > 8 ? (p[0] | p[1] << 8) >> (depth - 8) : p[0];
+    }
+  }
+  return sum / (n * n);
+}
+
+int frameIdDecode(const struct frameIdLayout *layout, const uint8_t *luma,
+                  int stride, int step, int depth, uint32_t *frame)
+{
+  int white = 0, black = 0;
+  for (int i = 0; i < FRAMEID_COLUMNS; ++i) {
+    int v = sampleCell(layout, i, luma, stride, step, depth);
+    if (i & 1) {
+      black += v;
+    } else {
+      white += v;
+    }
+  }
+  white /= FRAMEID_COLUMNS / 2;
+  black /= FRAMEID_COLUMNS / 2;
+  if (white - black < MIN_CONTRAST) return FRAMEID_MISSING;
+
+  int threshold = (white + black) / 2;
+  uint64_t bits = 0;
+  for (int i = 0; i < 48; ++i) {
+    bits = bits << 1 | (sampleCell(layout, FRAMEID_COLUMNS + i, luma, stride, step, depth) > threshold);
+  }
+  *frame = bits >> 16;
+  return crc16(*frame) == (bits & 0xffff) ? FRAMEID_OK : FRAMEID_BADCRC;
+}
@@ -0,0 +1,52 @@
+/*
+ * Test Card - Machine readable frame ID
+ *
+ * The frame number and a CRC-16 of it are drawn as a grid of black
+ * and white cells in the bottom-left corner of the card, between the
+ * 5% and 10% overscan marks and clear of the border rasterbars. The
+ * lines bar above it is made shorter so that none of its patterns is
+ * drawn over. Black and white have no chroma, so the code survives any
+ * chroma subsampling, and the cells are aligned to even pixels and
+ * several pixels wide to survive mild scaling and compression too. The
+ * first row alternates white and black and gives the decoder its
+ * threshold.
+ *
+ * This does not depend on SDL so that tools/analyze can share it.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_FRAMEID_H
+#define TESTCARD_FRAMEID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAMEID_COLUMNS 12
+#define FRAMEID_ROWS    5
+#define FRAMEID_CELLS   (FRAMEID_COLUMNS * FRAMEID_ROWS)
+
+// Results of frameIdDecode()
+#define FRAMEID_OK      0
+#define FRAMEID_MISSING 1
+#define FRAMEID_BADCRC  2
+
+// Top-left corner of the grid and the size of its square cells.
+struct frameIdLayout {
+  int x, y, cell;
+};
+
+// Where the code goes on a w by h card. Returns false when the card is
+// too small to fit it.
+bool frameIdLayout(int w, int h, struct frameIdLayout *layout);
+
+// Cell colors, 1 for white and 0 for black, row by row.
+void frameIdEncode(uint32_t frame, uint8_t cells[FRAMEID_CELLS]);
+
+// Read the code from a luma plane. Samples are step bytes apart
+// horizontally and stride bytes vertically. Above 8 bits per sample
+// they are 16-bit little-endian words with depth significant bits.
+int frameIdDecode(const struct frameIdLayout *layout, const uint8_t *luma,
+                  int stride, int step, int depth, uint32_t *frame);
+
+#endif
@@ -0,0 +1,474 @@
+/*
+ * Test Card - Rectangle painter with occlusion culling
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <SDL.h>
+
+#include "arena.h"
+#include "paint.h"
+
+#define OP_SOLID   0
+#define OP_CHECKER 1
+#define OP_VLINES  2
+#define OP_HLINES  3
+// already painted, e.g. under text, only hides what is below
+#define OP_DONE    4
+
+// Visible runs of a rectangle closer than this are painted as one. The
+// pixels in between get painted over again by the later rectangles but
+// that is cheaper than many short runs.
+#define MERGE_GAP 32
+
+// writes per pixel shown separately in the histogram, the last one
+// collects everything above
+#define COUNT_BINS 10
+
+struct op {
+  int x0, y0, x1, y1;
+  int kind;
+  // unclipped top-left corner and line width of the patterns
+  int x, y, l;
+  Uint32 color1, color2;
+};
+
+// a visible part of an operation, rows y0 to y1 with the same run
+struct span {
+  int op, x0, y0, x1, y1;
+};
+
+struct paint {
+  bool culling;
+  bool counting;
+  // set when an operation could not be queued
+  bool failed;
+
+  struct arena *arena;
+  SDL_Surface *target;
+  struct arenaBlock ops;
+  int opCount;
+  struct arenaBlock spans;
+  int spanCount;
+
+  // one bit per pixel of the clip rectangle, set once the pixel has its
+  // final color, and a second bitmap below it of the pixels painted
+  // before this resolve that must not be painted over again
+  struct arenaBlock coverage;
+  int coverageStride, coverageX, coverageY, coverageH;
+
+  struct arenaBlock counts;
+  int countsW, countsH;
+};
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+// First clear bit in [x, end) or end.
+static inline int findClear(const Uint64 *row, int x, int end)
+{
+  int i = x >> 6;
+  Uint64 bits = ~row[i] & (~(Uint64)0 << (x & 63));
+  while (!bits) {
+    if (++i << 6 >= end) return end;
+    bits = ~row[i];
+  }
+  return mini(end, (i << 6) + __builtin_ctzll(bits));
+}
+
+// First set bit in [x, end) or end.
+static inline int findSet(const Uint64 *row, int x, int end)
+{
+  int i = x >> 6;
+  Uint64 bits = row[i] & (~(Uint64)0 << (x & 63));
+  while (!bits) {
+    if (++i << 6 >= end) return end;
+    bits = row[i];
+  }
+  return mini(end, (i << 6) + __builtin_ctzll(bits));
+}
+
+static inline void setBits(Uint64 *row, int x, int end, bool on)
+{
+  if (x >= end) return;
+  int i = x >> 6, j = (end - 1) >> 6;
+  Uint64 first = ~(Uint64)0 << (x & 63);
+  Uint64 last = ~(Uint64)0 >> (63 - ((end - 1) & 63));
+  if (i == j) {
+    first &= last;
+  }
+  row[i] = on ? row[i] | first : row[i] & ~first;
+  if (i == j) return;
+  for (++i; i < j; ++i) {
+    row[i] = on ? ~(Uint64)0 : 0;
+  }
+  row[j] = on ? row[j] | last : row[j] & ~last;
+}
+
+static void count(struct paint *p, int x0, int y0, int x1, int y1)
+{
+  if (!p->counting || !p->counts.data) return;
+  for (int j = y0; j < y1; ++j) {
+    Uint8 *c = (Uint8 *)p->counts.data + (size_t)j * p->countsW;
+    for (int i = x0; i < x1; ++i) {
+      c[i] += c[i] < 255;
+    }
+  }
+}
+
+// Paint the part x0..x1, y0..y1 of an operation.
+static void drawRect(struct paint *p, const struct op *op, int x0, int y0, int x1, int y1)
+{
+  count(p, x0, y0, x1, y1);
+
+  if (op->kind == OP_SOLID) {
+    SDL_Rect r = {x0, y0, x1 - x0, y1 - y0};
+    SDL_FillRect(p->target, &r, op->color1);
+    return;
+  }
+  if (op->kind == OP_HLINES) {
+    for (int j = y0; j < y1; ) {
+      int k = (j - op->y) / op->l;
+      int end = mini(y1, op->y + (k+1) * op->l);
+      SDL_Rect r = {x0, j, x1 - x0, end - j};
+      SDL_FillRect(p->target, &r, (k & 1) ? op->color2 : op->color1);
+      j = end;
+    }
+    return;
+  }
+
+  SDL_Surface *target = p->target;
+  if(SDL_MUSTLOCK(target)) {
+    if(SDL_LockSurface(target) < 0 ) {
+      p->failed = true;
+      return;
+    }
+  }
+  for (int j = y0; j < y1; ++j) {
+    Uint32 *row = (Uint32 *)((Uint8 *)target->pixels + j * target->pitch);
+    if (op->kind == OP_VLINES) {
+      // every row is the same
+      if (j > y0) {
+        memcpy(row + x0, (Uint8 *)(row + x0) - target->pitch, (x1 - x0) * sizeof(*row));
+        continue;
+      }
+      for (int i = x0; i < x1; ) {
+        int k = (i - op->x) / op->l;
+        int end = mini(x1, op->x + (k+1) * op->l);
+        Uint32 c = (k & 1) ? op->color2 : op->color1;
+        for (; i < end; ++i) {
+          row[i] = c;
+        }
+      }
+      continue;
+    }
+    // color2 where x - left + y is even
+    int i = x0;
+    if ((i ^ op->x ^ j) & 1) {
+      row[i++] = op->color1;
+    }
+    for (; i + 1 < x1; i += 2) {
+      row[i] = op->color2;
+      row[i+1] = op->color1;
+    }
+    if (i < x1) {
+      row[i] = op->color2;
+    }
+  }
+  if(SDL_MUSTLOCK(target)) {
+    SDL_UnlockSurface(target);
+  }
+}
+
+// Clip to the surface the same way SDL_FillRect() does, including the
+// 16-bit SDL_Rect fields.
+static bool clip(struct paint *p, struct op *op, int x, int y, int w, int h)
+{
+  SDL_Rect r = {x, y, w, h};
+  const SDL_Rect *c = &p->target->clip_rect;
+  op->x = r.x;
+  op->y = r.y;
+  op->l = 1;
+  op->x0 = maxi(r.x, c->x);
+  op->y0 = maxi(r.y, c->y);
+  op->x1 = mini(r.x + r.w, c->x + c->w);
+  op->y1 = mini(r.y + r.h, c->y + c->h);
+  return op->x0 < op->x1 && op->y0 < op->y1;
+}
+
+// Make room for twice as many items. Returns false and leaves the
+// array as it was when out of memory.
+static bool grow(struct paint *p, struct arenaBlock *array, size_t item)
+{
+  return arenaGet(p->arena, array, maxi(256 * item, 2 * array->size), true);
+}
+
+static inline void addSpan(struct paint *p, int op, int y, int x0, int x1)
+{
+  // extend the one above when it is the same run
+  struct span *spans = p->spans.data;
+  if (p->spanCount) {
+    struct span *s = &spans[p->spanCount-1];
+    if (s->op == op && s->y1 == y && s->x0 == x0 && s->x1 == x1) {
+      s->y1 = y + 1;
+      return;
+    }
+  }
+  if ((p->spanCount + 1) * sizeof(*spans) > p->spans.size) {
+    if (!grow(p, &p->spans, sizeof(*spans))) {
+      p->failed = true;
+      return;
+    }
+    spans = p->spans.data;
+  }
+  struct span *s = &spans[p->spanCount++];
+  s->op = op;
+  s->x0 = x0;
+  s->y0 = y;
+  s->x1 = x1;
+  s->y1 = y + 1;
+}
+
+// Find what is visible of the queue inside the rectangle going from the
+// last operation to the first, then paint those runs from first to
+// last so that the pixels painted twice end up right.
+static void resolve(struct paint *p, int x0, int y0, int x1, int y1)
+{
+  // the bitmaps start at the corner of the clip rectangle
+  int ox = p->coverageX, oy = p->coverageY;
+  x0 -= ox;
+  x1 -= ox;
+  y0 -= oy;
+  y1 -= oy;
+  Uint64 *const coverage = p->coverage.data;
+  const struct op *const ops = p->ops.data;
+  size_t fixed = (size_t)p->coverageStride * p->coverageH;
+  for (int j = y0; j < y1; ++j) {
+    setBits(coverage + (size_t)j * p->coverageStride, x0, x1, false);
+    setBits(coverage + fixed + (size_t)j * p->coverageStride, x0, x1, false);
+  }
+  p->spanCount = 0;
+  for (int k = p->opCount - 1; k >= 0; --k) {
+    const struct op *op = &ops[k];
+    int i0 = maxi(op->x0 - ox, x0), i1 = mini(op->x1 - ox, x1);
+    int j0 = maxi(op->y0 - oy, y0), j1 = mini(op->y1 - oy, y1);
+    if (i0 >= i1 || j0 >= j1) continue;
+    for (int j = j0; j < j1; ++j) {
+      Uint64 *row = coverage + (size_t)j * p->coverageStride;
+      if (op->kind != OP_DONE) {
+        int start = -1, end = -1;
+        for (int i = findClear(row, i0, i1); i < i1; i = findClear(row, i, i1)) {
+          if (start >= 0 && (i - end > MERGE_GAP || findSet(row + fixed, end, i) < i)) {
+            addSpan(p, k, j + oy, start + ox, end + ox);
+            start = -1;
+          }
+          if (start < 0) start = i;
+          i = end = findSet(row, i, i1);
+        }
+        if (start >= 0) addSpan(p, k, j + oy, start + ox, end + ox);
+      } else {
+        setBits(row + fixed, i0, i1, true);
+      }
+      setBits(row, i0, i1, true);
+    }
+  }
+
+  const struct span *spans = p->spans.data;
+  for (int s = p->spanCount - 1; s >= 0; --s) {
+    const struct span *r = &spans[s];
+    drawRect(p, &ops[r->op], r->x0, r->y0, r->x1, r->y1);
+  }
+}
+
+static void queue(struct paint *p, const struct op *op)
+{
+  if (!p->culling || !p->coverage.data) {
+    if (op->kind != OP_DONE) drawRect(p, op, op->x0, op->y0, op->x1, op->y1);
+    return;
+  }
+  if ((p->opCount + 1) * sizeof(*op) > p->ops.size && !grow(p, &p->ops, sizeof(*op))) {
+    p->failed = true;
+    return;
+  }
+  ((struct op *)p->ops.data)[p->opCount++] = *op;
+}
+
+void paintSetCulling(struct paint *p, bool on)
+{
+  p->culling = on;
+}
+
+void paintSetCounting(struct paint *p, bool on)
+{
+  p->counting = on;
+}
+
+void paintBegin(struct paint *p, SDL_Surface *surface)
+{
+  p->target = surface;
+  p->opCount = 0;
+  p->failed = false;
+
+  if (p->culling) {
+    const SDL_Rect *c = &surface->clip_rect;
+    p->coverageStride = (c->w + 63) / 64;
+    p->coverageX = c->x;
+    p->coverageY = c->y;
+    p->coverageH = c->h;
+    size_t size = 2 * (size_t)p->coverageStride * c->h * sizeof(Uint64);
+    // without the bitmaps everything is painted right away
+    if (!arenaGet(p->arena, &p->coverage, size, false)) {
+      arenaRelease(p->arena, &p->coverage);
+    }
+  }
+
+  if (p->counting) {
+    size_t size = (size_t)surface->w * surface->h;
+    p->countsW = surface->w;
+    p->countsH = surface->h;
+    if (arenaGet(p->arena, &p->counts, size, false)) {
+      memset(p->counts.data, 0, size);
+    } else {
+      arenaRelease(p->arena, &p->counts);
+    }
+  }
+}
+
+void paintRect(struct paint *p, int x, int y, int w, int h, Uint32 color)
+{
+  struct op op;
+  if (!clip(p, &op, x, y, w, h)) return;
+  op.kind = OP_SOLID;
+  op.color1 = op.color2 = color;
+  queue(p, &op);
+}
+
+void paintChecker(struct paint *p, int x, int y, int w, int h, Uint32 color1, Uint32 color2)
+{
+  struct op op;
+  if (!clip(p, &op, x, y, w, h)) return;
+  op.kind = OP_CHECKER;
+  op.color1 = color1;
+  op.color2 = color2;
+  queue(p, &op);
+}
+
+void paintLines(struct paint *p, int x, int y, int w, int h, int l, bool vertical, Uint32 color1, Uint32 color2)
+{
+  struct op op;
+  if (l < 1 || !clip(p, &op, x, y, w, h)) return;
+  op.kind = vertical ? OP_VLINES : OP_HLINES;
+  op.l = l;
+  op.color1 = color1;
+  op.color2 = color2;
+  queue(p, &op);
+}
+
+void paintFlush(struct paint *p, int x, int y, int w, int h)
+{
+  struct op op;
+  if (!clip(p, &op, x, y, w, h)) return;
+  if (p->culling && p->coverage.data) {
+    resolve(p, op.x0, op.y0, op.x1, op.y1);
+  }
+  // whatever is drawn over the box counts as one write
+  count(p, op.x0, op.y0, op.x1, op.y1);
+  op.kind = OP_DONE;
+  queue(p, &op);
+}
+
+static void report(const struct paint *p)
+{
+  Uint64 histogram[COUNT_BINS] = {0};
+  Uint64 total = 0;
+  const Uint8 *counts = p->counts.data;
+  size_t n = (size_t)p->countsW * p->countsH;
+  for (size_t i = 0; i < n; ++i) {
+    ++histogram[mini(counts[i], COUNT_BINS-1)];
+    total += counts[i];
+  }
+
+  fwprintf(stdout, L"Overdraw: %llu pixel writes for %llu pixels (%.2f per pixel)%s\n",
+           (unsigned long long)total, (unsigned long long)n, (double)total / n,
+           p->culling ? "" : " without culling");
+  for (int i = 0; i < COUNT_BINS; ++i) {
+    if (!histogram[i]) continue;
+    fwprintf(stdout, L"%s%d writes %10llu pixels %5.1f%%\n", i == COUNT_BINS-1 ? ">=" : "  ",
+             i, (unsigned long long)histogram[i], 100. * histogram[i] / n);
+  }
+}
+
+bool paintEnd(struct paint *p)
+{
+  if (p->culling && p->coverage.data && p->target) {
+    const SDL_Rect *c = &p->target->clip_rect;
+    resolve(p, c->x, c->y, c->x + c->w, c->y + c->h);
+  }
+  p->opCount = 0;
+  if (p->counting && p->counts.data) {
+    report(p);
+  }
+  return !p->failed;
+}
+
+bool paintSaveOverdraw(const struct paint *p, const char *fileName)
+{
+  if (!p->counts.data) return false;
+
+  // black for never written, then blue, green, yellow, red and white
+  // for one to five or more writes
+  static const Uint8 heat[6][3] = {
+    {0, 0, 0}, {0, 0, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}, {255, 255, 255},
+  };
+  SDL_Surface *map = SDL_CreateRGBSurface(SDL_SWSURFACE, p->countsW, p->countsH, 32,
+                                          0xff0000, 0x00ff00, 0x0000ff, 0);
+  if (!map) {
+    fprintf(stderr, "SDL_CreateRGBSurface: %s\n", SDL_GetError());
+    return false;
+  }
+  for (int j = 0; j < p->countsH; ++j) {
+    Uint32 *row = (Uint32 *)((Uint8 *)map->pixels + j * map->pitch);
+    const Uint8 *c = (const Uint8 *)p->counts.data + (size_t)j * p->countsW;
+    for (int i = 0; i < p->countsW; ++i) {
+      const Uint8 *rgb = heat[mini(c[i], 5)];
+      row[i] = SDL_MapRGB(map->format, rgb[0], rgb[1], rgb[2]);
+    }
+  }
+  bool ok = !SDL_SaveBMP(map, fileName);
+  if (!ok) {
+    fprintf(stderr, "SDL_SaveBMP(\"%s\"): %s\n", fileName, SDL_GetError());
+  }
+  SDL_FreeSurface(map);
+  return ok;
+}
+
+struct paint *paintCreate(struct arena *arena)
+{
+  struct paint *p = calloc(1, sizeof(*p));
+  if (!p) return NULL;
+  p->arena = arena;
+  p->culling = true;
+  return p;
+}
+
+void paintFree(struct paint *p)
+{
+  if (!p) return;
+  arenaRelease(p->arena, &p->ops);
+  arenaRelease(p->arena, &p->spans);
+  arenaRelease(p->arena, &p->coverage);
+  arenaRelease(p->arena, &p->counts);
+  free(p);
+}
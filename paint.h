@@ -0,0 +1,70 @@
+/*
+ * Test Card - Rectangle painter with occlusion culling
+ *
+ * The card is mostly opaque rectangles drawn on top of each other, so
+ * instead of filling them right away they are queued and what is left
+ * visible of each one is found going back to front. Only those parts
+ * are then painted, with short hidden gaps filled in when that is
+ * cheaper than skipping them, so the result is bit identical to
+ * drawing everything in order with far fewer writes.
+ * Text is blended over what is below it, so the queue is painted
+ * under a text box before the text is drawn.
+ *
+ * Optionally every pixel write is counted to show how much overdraw
+ * rendering the card takes.
+ *
+ * The queue and the bitmaps belong to a paint object, one for each
+ * thread that renders, and are kept in the arena it is given.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_PAINT_H
+#define TESTCARD_PAINT_H
+
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "arena.h"
+
+struct paint;
+
+// A painter with its buffers in arena, NULL when out of memory.
+struct paint *paintCreate(struct arena *arena);
+void paintFree(struct paint *p);
+
+// Turn occlusion culling on (the default) or off. Without culling
+// rectangles are filled as soon as they are queued.
+void paintSetCulling(struct paint *p, bool on);
+
+// Count the writes to every pixel and print a histogram of them when
+// a render is finished.
+void paintSetCounting(struct paint *p, bool on);
+
+// Start painting a new frame on a 32 bits per pixel surface. Only its
+// clip rectangle is painted and tracked.
+void paintBegin(struct paint *p, SDL_Surface *surface);
+
+// Fill a rectangle like SDL_FillRect() would.
+void paintRect(struct paint *p, int x, int y, int w, int h, Uint32 color);
+
+// Fill a rectangle with a one pixel checkerboard, color2 on the pixels
+// whose distance from the left edge has the same parity as the row.
+void paintChecker(struct paint *p, int x, int y, int w, int h, Uint32 color1, Uint32 color2);
+
+// Fill a rectangle with color1 and lines l pixels wide in color2, l
+// pixels apart and starting l pixels from the left or top edge.
+void paintLines(struct paint *p, int x, int y, int w, int h, int l, bool vertical, Uint32 color1, Uint32 color2);
+
+// Paint everything queued under the rectangle so that it can be drawn
+// over, e.g. by blending text.
+void paintFlush(struct paint *p, int x, int y, int w, int h);
+
+// Paint everything still queued and print the overdraw histogram when
+// counting. Returns false if anything was left out for lack of memory.
+bool paintEnd(struct paint *p);
+
+// Save the write counts of the last frame as a heat map.
+bool paintSaveOverdraw(const struct paint *p, const char *fileName);
+
+#endif
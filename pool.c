@@ -0,0 +1,144 @@
+/*
+ * Test Card - Thread pool
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include <SDL.h>
+
+#include "pool.h"
+
+#define MAX_THREADS 32
+
+struct pool {
+  int threads;
+  SDL_Thread *thread[MAX_THREADS];
+  SDL_mutex *lock;
+  // work is signalled for a new batch, done when the last item of it
+  // is finished
+  SDL_cond *work, *done;
+  bool quit;
+  // the batch, next is the first item nobody has taken yet
+  unsigned batch;
+  void (*job)(void *item);
+  char *items;
+  size_t size;
+  int count, next, pending;
+};
+
+static int cpuCount(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? n : 1;
+#else
+  return 1;
+#endif
+}
+
+// Take and run items of the batch until there are none left. Called
+// and returns with the lock held.
+static void runItems(struct pool *pool)
+{
+  while (pool->next < pool->count) {
+    char *item = pool->items + pool->next++ * pool->size;
+    SDL_UnlockMutex(pool->lock);
+    pool->job(item);
+    SDL_LockMutex(pool->lock);
+    if (!--pool->pending) SDL_CondSignal(pool->done);
+  }
+}
+
+static int worker(void *data)
+{
+  struct pool *pool = data;
+  unsigned seen = 0;
+  SDL_LockMutex(pool->lock);
+  for (;;) {
+    while (!pool->quit && pool->batch == seen) {
+      SDL_CondWait(pool->work, pool->lock);
+    }
+    if (pool->quit) break;
+    seen = pool->batch;
+    runItems(pool);
+  }
+  SDL_UnlockMutex(pool->lock);
+  return 0;
+}
+
+struct pool *poolCreate(int threads)
+{
+  struct pool *pool = calloc(1, sizeof(*pool));
+  if (!pool) return NULL;
+  if (threads <= 0) threads = cpuCount();
+  if (threads > MAX_THREADS) threads = MAX_THREADS;
+  pool->threads = 1;
+  if (threads == 1) return pool;
+
+  pool->lock = SDL_CreateMutex();
+  pool->work = SDL_CreateCond();
+  pool->done = SDL_CreateCond();
+  if (!pool->lock || !pool->work || !pool->done) {
+    poolFree(pool);
+    return NULL;
+  }
+  for (int i = 0; i < threads - 1; ++i) {
+    pool->thread[i] = SDL_CreateThread(worker, pool);
+    if (!pool->thread[i]) break;
+    ++pool->threads;
+  }
+  return pool;
+}
+
+void poolFree(struct pool *pool)
+{
+  if (!pool) return;
+  if (pool->lock) {
+    SDL_LockMutex(pool->lock);
+    pool->quit = true;
+    SDL_CondBroadcast(pool->work);
+    SDL_UnlockMutex(pool->lock);
+  }
+  for (int i = 0; i < pool->threads - 1; ++i) {
+    SDL_WaitThread(pool->thread[i], NULL);
+  }
+  if (pool->done) SDL_DestroyCond(pool->done);
+  if (pool->work) SDL_DestroyCond(pool->work);
+  if (pool->lock) SDL_DestroyMutex(pool->lock);
+  free(pool);
+}
+
+int poolThreads(const struct pool *pool)
+{
+  return pool->threads;
+}
+
+void poolRun(struct pool *pool, void (*job)(void *item), void *items, size_t size, int count)
+{
+  if (pool->threads == 1 || count <= 1) {
+    for (int i = 0; i < count; ++i) {
+      job((char *)items + i * size);
+    }
+    return;
+  }
+
+  SDL_LockMutex(pool->lock);
+  pool->job = job;
+  pool->items = items;
+  pool->size = size;
+  pool->count = count;
+  pool->next = 0;
+  pool->pending = count;
+  ++pool->batch;
+  SDL_CondBroadcast(pool->work);
+  runItems(pool);
+  while (pool->pending) {
+    SDL_CondWait(pool->done, pool->lock);
+  }
+  SDL_UnlockMutex(pool->lock);
+}
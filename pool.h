@@ -0,0 +1,31 @@
+/*
+ * Test Card - Thread pool
+ *
+ * A few threads that are started once and then wait for work, so that
+ * splitting a stage between the CPUs does not start and join threads
+ * on every frame. Each render context has a pool of its own.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_POOL_H
+#define TESTCARD_POOL_H
+
+#include <stddef.h>
+
+struct pool;
+
+// A pool of threads in all, counting the one that runs the jobs, 0
+// for one per CPU. Returns NULL when out of memory. Threads that can
+// not be started are left out.
+struct pool *poolCreate(int threads);
+void poolFree(struct pool *pool);
+
+// Number of threads the jobs are split between.
+int poolThreads(const struct pool *pool);
+
+// Call job on count items of size bytes starting from items, spread
+// over the pool and the calling thread. Returns when all are done.
+void poolRun(struct pool *pool, void (*job)(void *item), void *items, size_t size, int count);
+
+#endif
@@ -0,0 +1,323 @@
+/*
+ * Test Card - Shared memory frame ring
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Pixels start on a cache line and slots on a page.
+#define LINE 64
+#define PAGE 4096
+
+struct ring {
+  struct ringHeader *header;
+  size_t size;
+  // set when this process created the object and removes it, which
+  // is the one with this inode as long as the name is not taken over
+  char *name;
+  dev_t device;
+  ino_t inode;
+};
+
+static inline size_t roundUp(size_t n, size_t a)
+{
+  return (n + a - 1) / a * a;
+}
+
+// Whether the ring of that name was left behind by a card that is no
+// longer running. Anything else, a live writer or an object that is
+// not a ring at all, is not replaced and an error is printed.
+static bool stale(const char *name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    // removed meanwhile
+    return errno == ENOENT;
+  }
+  struct stat st;
+  void *p = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct ringHeader)) {
+    p = mmap(NULL, sizeof(struct ringHeader), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "%s: Exists and is not a test card frame ring, not replacing it\n", name);
+    return false;
+  }
+  const struct ringHeader *h = p;
+  bool ring = __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == RING_MAGIC;
+  pid_t writer = h->writer;
+  munmap(p, sizeof(struct ringHeader));
+  if (!ring) {
+    fprintf(stderr, "%s: Exists and is not a test card frame ring, not replacing it\n", name);
+    return false;
+  }
+  // signal 0 only checks that the process exists
+  if (writer > 0 && (kill(writer, 0) == 0 || errno == EPERM)) {
+    fprintf(stderr, "%s: Already written by process %d\n", name, (int)writer);
+    return false;
+  }
+  return true;
+}
+
+static struct ringFrame *slot(const struct ring *ring, uint64_t n)
+{
+  const struct ringHeader *h = ring->header;
+  return (struct ringFrame *)((uint8_t *)ring->header + h->headerSize + (n % h->slots) * h->slotSize);
+}
+
+struct ring *ringCreate(const char *name, size_t frameBytes)
+{
+  struct ring *ring = calloc(1, sizeof(*ring));
+  if (ring) ring->name = malloc(strlen(name) + 1);
+  if (!ring || !ring->name) {
+    fprintf(stderr, "malloc: Out of memory\n");
+    free(ring);
+    return NULL;
+  }
+  strcpy(ring->name, name);
+
+  size_t headerSize = roundUp(sizeof(struct ringHeader), PAGE);
+  size_t slotSize = roundUp(roundUp(sizeof(struct ringFrame), LINE) + frameBytes, PAGE);
+  ring->size = headerSize + RING_SLOTS * slotSize;
+
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0 && errno == EEXIST) {
+    if (!stale(name)) {
+      ringClose(ring);
+      return NULL;
+    }
+    // a fresh object, readers still mapping the old one keep theirs
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  }
+  if (fd < 0) {
+    fprintf(stderr, "shm_open(\"%s\"): %s\n", name, strerror(errno));
+    ringClose(ring);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    fprintf(stderr, "fstat(\"%s\"): %s\n", name, strerror(errno));
+    close(fd);
+    shm_unlink(name);
+    ringClose(ring);
+    return NULL;
+  }
+  ring->device = st.st_dev;
+  ring->inode = st.st_ino;
+  if (ftruncate(fd, ring->size) < 0) {
+    fprintf(stderr, "ftruncate(\"%s\"): %s\n", name, strerror(errno));
+    close(fd);
+    shm_unlink(name);
+    ringClose(ring);
+    return NULL;
+  }
+  void *p = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "mmap(\"%s\"): %s\n", name, strerror(errno));
+    shm_unlink(name);
+    ringClose(ring);
+    return NULL;
+  }
+  ring->header = p;
+
+  // the object starts out zeroed and readers wait for the magic
+  struct ringHeader *h = ring->header;
+  h->version = RING_VERSION;
+  h->slots = RING_SLOTS;
+  h->headerSize = headerSize;
+  h->slotSize = slotSize;
+  h->writer = getpid();
+  __atomic_store_n(&h->magic, RING_MAGIC, __ATOMIC_RELEASE);
+  return ring;
+}
+
+struct ring *ringOpen(const char *name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "shm_open(\"%s\"): %s\n", name, strerror(errno));
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    fprintf(stderr, "fstat(\"%s\"): %s\n", name, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  void *p = st.st_size >= (off_t)sizeof(struct ringHeader) ?
+    mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "mmap(\"%s\"): %s\n", name, st.st_size ? strerror(errno) : "Empty object");
+    return NULL;
+  }
+
+  const struct ringHeader *h = p;
+  if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != RING_MAGIC || h->version != RING_VERSION ||
+      !h->slots || h->headerSize + (uint64_t)h->slots * h->slotSize > (uint64_t)st.st_size) {
+    fprintf(stderr, "%s: Not a test card frame ring of version %d\n", name, RING_VERSION);
+    munmap(p, st.st_size);
+    return NULL;
+  }
+
+  struct ring *ring = calloc(1, sizeof(*ring));
+  if (!ring) {
+    fprintf(stderr, "malloc: Out of memory\n");
+    munmap(p, st.st_size);
+    return NULL;
+  }
+  ring->header = p;
+  ring->size = st.st_size;
+  return ring;
+}
+
+void ringClose(struct ring *ring)
+{
+  if (!ring) return;
+  if (ring->header) munmap(ring->header, ring->size);
+  if (ring->name) {
+    // another card may have replaced it after this one was thought gone
+    int fd = ring->header ? shm_open(ring->name, O_RDONLY, 0) : -1;
+    struct stat st;
+    if (fd >= 0) {
+      if (fstat(fd, &st) == 0 && st.st_dev == ring->device && st.st_ino == ring->inode) {
+        shm_unlink(ring->name);
+      }
+      close(fd);
+    }
+    free(ring->name);
+  }
+  free(ring);
+}
+
+bool ringPublish(struct ring *ring, const struct ringFormat *format, const void *pixels, uint64_t number)
+{
+  struct ringHeader *h = ring->header;
+  size_t row = (size_t)format->width * format->bytesPerPixel;
+  size_t frameSize = roundUp(sizeof(struct ringFrame), LINE);
+  if (frameSize + row * format->height > h->slotSize) return false;
+
+  uint64_t n = __atomic_load_n(&h->published, __ATOMIC_RELAXED);
+  struct ringFrame *f = slot(ring, n);
+  // readers must see the odd count before any of the new frame
+  __atomic_store_n(&f->sequence, 2*n + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  f->number = number;
+  f->time = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  f->frameSize = frameSize;
+  f->width = format->width;
+  f->height = format->height;
+  f->pitch = row;
+  f->bytesPerPixel = format->bytesPerPixel;
+  f->rmask = format->rmask;
+  f->gmask = format->gmask;
+  f->bmask = format->bmask;
+  f->amask = format->amask;
+  strncpy(f->mode, format->mode ? format->mode : "", sizeof(f->mode) - 1);
+  f->mode[sizeof(f->mode) - 1] = '\0';
+  uint8_t *dst = (uint8_t *)f + frameSize;
+  for (int j = 0; j < format->height; ++j) {
+    memcpy(dst + j * row, (const uint8_t *)pixels + (size_t)j * format->pitch, row);
+  }
+
+  __atomic_store_n(&f->sequence, 2*n + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&h->published, n + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+uint64_t ringPublished(const struct ring *ring)
+{
+  return __atomic_load_n(&ring->header->published, __ATOMIC_ACQUIRE);
+}
+
+const uint8_t *ringBegin(const struct ring *ring, uint64_t n, struct ringFrame *frame)
+{
+  const struct ringFrame *f = slot(ring, n);
+  if (__atomic_load_n(&f->sequence, __ATOMIC_ACQUIRE) != 2*n + 2) return NULL;
+  *frame = *f;
+  frame->mode[sizeof(frame->mode) - 1] = '\0';
+  // a frame being overwritten can have any size, it must not take the
+  // reader outside the slot
+  if (frame->frameSize + (uint64_t)frame->pitch * frame->height > ring->header->slotSize ||
+      (uint64_t)frame->width * frame->bytesPerPixel > frame->pitch) {
+    return NULL;
+  }
+  return (const uint8_t *)f + frame->frameSize;
+}
+
+bool ringEnd(const struct ring *ring, uint64_t n)
+{
+  // whatever was read comes before checking the count again
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&slot(ring, n)->sequence, __ATOMIC_RELAXED) == 2*n + 2;
+}
+
+#else
+
+// No POSIX shared memory, -m is not available.
+
+struct ring *ringCreate(const char *name, size_t frameBytes)
+{
+  (void)frameBytes;
+  fprintf(stderr, "%s: Shared memory rings are not supported on this platform\n", name);
+  return NULL;
+}
+
+struct ring *ringOpen(const char *name)
+{
+  return ringCreate(name, 0);
+}
+
+void ringClose(struct ring *ring)
+{
+  (void)ring;
+}
+
+bool ringPublish(struct ring *ring, const struct ringFormat *format, const void *pixels, uint64_t number)
+{
+  (void)ring; (void)format; (void)pixels; (void)number;
+  return false;
+}
+
+uint64_t ringPublished(const struct ring *ring)
+{
+  (void)ring;
+  return 0;
+}
+
+const uint8_t *ringBegin(const struct ring *ring, uint64_t n, struct ringFrame *frame)
+{
+  (void)ring; (void)n; (void)frame;
+  return NULL;
+}
+
+bool ringEnd(const struct ring *ring, uint64_t n)
+{
+  (void)ring; (void)n;
+  return false;
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Test Card - Shared memory frame ring
+ *
+ * Publishes the frames shown on the screen, with their format and mode,
+ * in a POSIX shared memory object that other processes on the same host
+ * map and read in place, e.g. "testcard -m /testcard" and
+ * "tools/ringcat /testcard". The object is a header followed by a ring
+ * of slots, each a frame header and the pixels, and frame n goes into
+ * slot n % slots.
+ *
+ * There are no locks. Each slot has a sequence counter (a seqlock) that
+ * is odd while the frame in it is being written and 2n+2 once frame n
+ * is complete, and the header counts the frames published. A reader
+ * checks the counter before and after looking at a frame: if it
+ * changed, the frame was overwritten meanwhile and has to be
+ * discarded. Readers never write to the ring so any number of them can
+ * follow it, and a reader that falls behind by more than the ring only
+ * loses frames, it can not slow down the card.
+ *
+ * A ring belongs to the card that created it. A second card given the
+ * same name refuses to start while the writer named in the header is
+ * still running, and only replaces a ring left behind by one that is
+ * gone.
+ *
+ * This does not depend on SDL so that tools/ringcat can share it.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_RING_H
+#define TESTCARD_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_MAGIC   0x474e4952 // "RING"
+#define RING_VERSION 1
+#define RING_SLOTS   4
+
+// The header is followed by the slots, slotSize bytes each.
+struct ringHeader {
+  uint32_t magic, version;
+  uint32_t slots;
+  uint32_t headerSize;
+  uint64_t slotSize;
+  // frames published so far, the latest is frame published - 1
+  uint64_t published;
+  // process ID of the card writing the ring
+  uint64_t writer;
+};
+
+// The frame header is followed by the pixels at frameSize bytes from
+// its start, height rows of pitch bytes.
+struct ringFrame {
+  // 2n+1 while frame n is being written, 2n+2 when it is complete
+  uint64_t sequence;
+  // animation frame number, also in the frame ID with -b, and 0 for
+  // the still card
+  uint64_t number;
+  // CLOCK_MONOTONIC nanoseconds when published
+  uint64_t time;
+  uint32_t frameSize;
+  uint32_t width, height, pitch;
+  // bytes per pixel and the channel masks, e.g. 0xff0000 for red in
+  // the native byte order of 32-bit pixels
+  uint32_t bytesPerPixel;
+  uint32_t rmask, gmask, bmask, amask;
+  // chroma mode and other simulations as in the image info, e.g.
+  // "RGB" or "YCbCr 4:2:0, Interlaced bob"
+  char mode[80];
+};
+
+struct ring;
+
+// Pixel format and mode of a published frame.
+struct ringFormat {
+  int width, height, pitch;
+  int bytesPerPixel;
+  uint32_t rmask, gmask, bmask, amask;
+  const char *mode;
+};
+
+// Create the shared memory object name, e.g. "/testcard", with room
+// for frames of up to frameBytes bytes. Returns NULL and prints an
+// error on failure, also when another card is writing a ring of that
+// name.
+struct ring *ringCreate(const char *name, size_t frameBytes);
+
+// Map an existing ring read only. Returns NULL on failure.
+struct ring *ringOpen(const char *name);
+
+// Unmap the ring and remove it if this process created it and the name
+// still refers to it. Readers that have it mapped keep it until they
+// close it too.
+void ringClose(struct ring *ring);
+
+// Copy a frame into the next slot. Returns false if it does not fit.
+bool ringPublish(struct ring *ring, const struct ringFormat *format, const void *pixels, uint64_t number);
+
+// Number of frames published so far.
+uint64_t ringPublished(const struct ring *ring);
+
+// Start reading frame n. Its header is copied to frame and its pixels
+// are read in place from the pointer returned. Returns NULL if it is
+// not complete or has been overwritten already.
+const uint8_t *ringBegin(const struct ring *ring, uint64_t n, struct ringFrame *frame);
+
+// Finish reading frame n. Returns false if it was overwritten while
+// being read and whatever was read from it must be thrown away.
+bool ringEnd(const struct ring *ring, uint64_t n);
+
+#endif
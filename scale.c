@@ -0,0 +1,349 @@
+/*
+ * Test Card - Display scaler simulation
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "scale.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// fixed point weights, 1.0 is 1 << SHIFT
+#define SHIFT 14
+
+// Not worth a thread for fewer output rows than this
+#define MIN_ROWS 64
+#define MAX_THREADS 32
+
+const char * const SCALE_NAME[SCALE_KERNELS] = {
+  "none",
+  "nearest",
+  "bilinear",
+  "bicubic",
+  "lanczos",
+};
+
+// Weights of one direction, n of them for every output pixel i starting
+// from source pixel start[i]. Windows are shifted to stay inside the
+// source and padded with zero weights. They are kept for the next
+// frame with the sizes, zoom and kernel they were built for.
+struct taps {
+  int n;
+  int *start;
+  Sint16 *weights;
+  int srcSize, dstSize, kernel;
+  double zoom;
+  struct arenaBlock startBlock, weightsBlock;
+};
+
+// One band of output rows and the source rows it needs
+struct job {
+  SDL_Surface *dst, *src;
+  const struct taps *h, *v;
+  int y0, y1;
+  int s0, s1;
+  Uint8 *tmp;
+};
+
+struct scale {
+  struct pool *pool;
+  struct arena *arena;
+  struct taps h, v;
+  // kernel values of one output pixel while building the taps
+  struct arenaBlock window;
+  // horizontally scaled source rows of all the bands
+  struct arenaBlock scratch;
+};
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static double triangle(double x)
+{
+  x = fabs(x);
+  return x < 1 ? 1 - x : 0;
+}
+
+// Keys' cubic convolution with a = -0.5
+static double cubic(double x)
+{
+  const double a = -0.5;
+  x = fabs(x);
+  if (x < 1) return ((a + 2) * x - (a + 3)) * x * x + 1;
+  if (x < 2) return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+  return 0;
+}
+
+static double sinc(double x)
+{
+  if (x == 0) return 1;
+  x *= M_PI;
+  return sin(x) / x;
+}
+
+static double lanczos(double x)
+{
+  return fabs(x) < 3 ? sinc(x) * sinc(x / 3) : 0;
+}
+
+static const struct {
+  double (*f)(double);
+  double support;
+} kernels[SCALE_KERNELS] = {
+  {NULL, 0},
+  {NULL, 0.5},
+  {triangle, 1},
+  {cubic, 2},
+  {lanczos, 3},
+};
+
+// Weights for scaling srcSize pixels zoomed in by zoom to dstSize.
+// When shrinking the kernel is stretched to filter out what the output
+// can not show.
+static bool buildTaps(struct scale *s, struct taps *t, int srcSize, int dstSize, double zoom, int kernel)
+{
+  // reused until the arena lets go of them
+  if (t->startBlock.data && t->weightsBlock.data && t->srcSize == srcSize &&
+      t->dstSize == dstSize && t->zoom == zoom && t->kernel == kernel) {
+    return true;
+  }
+  t->srcSize = 0;
+
+  double scale = (double)srcSize / dstSize / zoom;
+  double offset = srcSize * (1 - 1 / zoom) / 2;
+  double filterScale = scale > 1 ? scale : 1;
+  double support = kernels[kernel].support * filterScale;
+  int n = kernel == SCALE_NEAREST ? 1 : mini(2 * (int)ceil(support) + 1, srcSize);
+
+  t->n = n;
+  t->start = arenaGet(s->arena, &t->startBlock, dstSize * sizeof(*t->start), false);
+  t->weights = arenaGet(s->arena, &t->weightsBlock, (size_t)dstSize * n * sizeof(*t->weights), false);
+  double *w = arenaGet(s->arena, &s->window, n * sizeof(*w), false);
+  if (!t->start || !t->weights || !w) {
+    return false;
+  }
+  memset(t->weights, 0, (size_t)dstSize * n * sizeof(*t->weights));
+
+  for (int i = 0; i < dstSize; ++i) {
+    double center = offset + (i + 0.5) * scale;
+    Sint16 *out = t->weights + i * n;
+    if (kernel == SCALE_NEAREST) {
+      t->start[i] = mini(maxi((int)floor(center), 0), srcSize - 1);
+      out[0] = 1 << SHIFT;
+      continue;
+    }
+
+    int x0 = maxi((int)floor(center - support + 0.5), 0);
+    int x1 = mini((int)floor(center + support + 0.5), srcSize);
+    if (x1 <= x0) {
+      // zoomed out past the edge, which is repeated
+      x0 = mini(maxi((int)floor(center), 0), srcSize - 1);
+      x1 = x0 + 1;
+    }
+    x1 = mini(x1, x0 + n);
+    double total = 0;
+    for (int x = x0; x < x1; ++x) {
+      total += w[x - x0] = kernels[kernel].f((x + 0.5 - center) / filterScale);
+    }
+
+    // rounded so that the weights add up to exactly one
+    int start = mini(x0, srcSize - n), sum = 0, peak = x0 - start;
+    for (int x = x0; x < x1; ++x) {
+      Sint16 c = total != 0 ? lround(w[x - x0] / total * (1 << SHIFT)) : 0;
+      out[x - start] = c;
+      sum += c;
+      if (c > out[peak]) peak = x - start;
+    }
+    out[peak] += (1 << SHIFT) - sum;
+    t->start[i] = start;
+  }
+  t->srcSize = srcSize;
+  t->dstSize = dstSize;
+  t->zoom = zoom;
+  t->kernel = kernel;
+  return true;
+}
+
+static inline Uint8 clamp8(int sum)
+{
+  return sum < 0 ? 0 : mini((sum + (1 << (SHIFT-1))) >> SHIFT, 255);
+}
+
+// Horizontal pass of one row of w output pixels.
+static void scaleRow(Uint8 *out, const Uint8 *in, const struct taps *t, int w)
+{
+  if (t->n == 1) {
+    // nearest neighbour
+    for (int i = 0; i < w; ++i, out += 4) {
+      memcpy(out, in + 4 * t->start[i], 4);
+    }
+    return;
+  }
+  for (int i = 0; i < w; ++i, out += 4) {
+    const Uint8 *p = in + 4 * t->start[i];
+    const Sint16 *c = t->weights + i * t->n;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_set1_epi32(1 << (SHIFT-1));
+    int k = 0;
+    for (; k + 2 <= t->n; k += 2) {
+      // channels of two neighbouring pixels interleaved for madd
+      __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p + 4*k)), zero);
+      px = _mm_unpacklo_epi16(px, _mm_unpackhi_epi64(px, px));
+      __m128i c2 = _mm_set1_epi32((Uint16)c[k] | (Uint32)(Uint16)c[k+1] << 16);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(px, c2));
+    }
+    if (k < t->n) {
+      Uint32 v;
+      memcpy(&v, p + 4*k, 4);
+      __m128i px = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32((Uint16)c[k])));
+    }
+    sum = _mm_srai_epi32(sum, SHIFT);
+    sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), zero);
+    Uint32 v = _mm_cvtsi128_si32(sum);
+    memcpy(out, &v, 4);
+#else
+    for (int ch = 0; ch < 4; ++ch) {
+      int sum = 0;
+      for (int k = 0; k < t->n; ++k) {
+        sum += c[k] * p[4*k + ch];
+      }
+      out[ch] = clamp8(sum);
+    }
+#endif
+  }
+}
+
+// Vertical pass of one row of bytes from n rows pitch apart.
+static void scaleColumns(Uint8 *out, const Uint8 *in, int pitch, const Sint16 *c, int n, int bytes)
+{
+  if (n == 1) {
+    memcpy(out, in, bytes);
+    return;
+  }
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(1 << (SHIFT-1));
+  for (; i + 16 <= bytes; i += 16) {
+    __m128i s0 = round, s1 = round, s2 = round, s3 = round;
+    for (int k = 0; k < n; k += 2) {
+      // two rows interleaved for madd, the odd one out with a zero row
+      __m128i a = _mm_loadu_si128((const __m128i *)(in + k * pitch + i));
+      __m128i b = k + 1 < n ? _mm_loadu_si128((const __m128i *)(in + (k+1) * pitch + i)) : zero;
+      __m128i c2 = _mm_set1_epi32((Uint16)c[k] | (k + 1 < n ? (Uint32)(Uint16)c[k+1] << 16 : 0));
+      __m128i alo = _mm_unpacklo_epi8(a, zero), ahi = _mm_unpackhi_epi8(a, zero);
+      __m128i blo = _mm_unpacklo_epi8(b, zero), bhi = _mm_unpackhi_epi8(b, zero);
+      s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi16(alo, blo), c2));
+      s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi16(alo, blo), c2));
+      s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi16(ahi, bhi), c2));
+      s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi16(ahi, bhi), c2));
+    }
+    __m128i lo = _mm_packs_epi32(_mm_srai_epi32(s0, SHIFT), _mm_srai_epi32(s1, SHIFT));
+    __m128i hi = _mm_packs_epi32(_mm_srai_epi32(s2, SHIFT), _mm_srai_epi32(s3, SHIFT));
+    _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < bytes; ++i) {
+    int sum = 0;
+    for (int k = 0; k < n; ++k) {
+      sum += c[k] * in[k * pitch + i];
+    }
+    out[i] = clamp8(sum);
+  }
+}
+
+static void scaleBand(void *data)
+{
+  const struct job *j = data;
+  int pitch = 4 * j->dst->w;
+  for (int y = j->s0; y < j->s1; ++y) {
+    scaleRow(j->tmp + (size_t)(y - j->s0) * pitch,
+             (const Uint8 *)j->src->pixels + y * j->src->pitch, j->h, j->dst->w);
+  }
+  for (int y = j->y0; y < j->y1; ++y) {
+    scaleColumns((Uint8 *)j->dst->pixels + y * j->dst->pitch,
+                 j->tmp + (size_t)(j->v->start[y] - j->s0) * pitch, pitch,
+                 j->v->weights + y * j->v->n, j->v->n, pitch);
+  }
+}
+
+struct scale *scaleCreate(struct pool *pool, struct arena *arena)
+{
+  struct scale *scale = calloc(1, sizeof(*scale));
+  if (!scale) return NULL;
+  scale->pool = pool;
+  scale->arena = arena;
+  return scale;
+}
+
+void scaleFree(struct scale *scale)
+{
+  if (!scale) return;
+  arenaRelease(scale->arena, &scale->h.startBlock);
+  arenaRelease(scale->arena, &scale->h.weightsBlock);
+  arenaRelease(scale->arena, &scale->v.startBlock);
+  arenaRelease(scale->arena, &scale->v.weightsBlock);
+  arenaRelease(scale->arena, &scale->window);
+  arenaRelease(scale->arena, &scale->scratch);
+  free(scale);
+}
+
+bool scaleSurface(struct scale *scale, SDL_Surface *dst, SDL_Surface *src, double zoom, int kernel)
+{
+  if (kernel <= SCALE_NONE || kernel >= SCALE_KERNELS || zoom <= 0) return true;
+
+  struct taps *h = &scale->h, *v = &scale->v;
+  if (!buildTaps(scale, h, src->w, dst->w, zoom, kernel) ||
+      !buildTaps(scale, v, src->h, dst->h, zoom, kernel)) {
+    return false;
+  }
+
+  // bands of output rows, each horizontally scales the source rows its
+  // vertical taps reach so that the threads never wait for each other
+  int threads = mini(mini(poolThreads(scale->pool), MAX_THREADS), maxi(dst->h / MIN_ROWS, 1));
+  struct job jobs[MAX_THREADS];
+  size_t size = 0;
+  for (int i = 0; i < threads; ++i) {
+    struct job *j = &jobs[i];
+    j->dst = dst;
+    j->src = src;
+    j->h = h;
+    j->v = v;
+    j->y0 = dst->h * i / threads;
+    j->y1 = dst->h * (i+1) / threads;
+    j->s0 = v->start[j->y0];
+    j->s1 = v->start[j->y1 - 1] + v->n;
+    size += (size_t)(j->s1 - j->s0) * 4 * dst->w;
+  }
+  Uint8 *tmp = arenaGet(scale->arena, &scale->scratch, size, false);
+  if (!tmp) return false;
+  for (int i = 0; i < threads; ++i) {
+    jobs[i].tmp = tmp;
+    tmp += (size_t)(jobs[i].s1 - jobs[i].s0) * 4 * dst->w;
+  }
+
+  // both are software surfaces of the render context
+  poolRun(scale->pool, scaleBand, jobs, sizeof(jobs[0]), threads);
+  return true;
+}
@@ -0,0 +1,50 @@
+/*
+ * Test Card - Display scaler simulation
+ *
+ * Resamples the rendered card the way the scaler of a TV or monitor
+ * does when the signal does not match the panel: the centre of the
+ * card is cropped by the overscan zoom (e.g. 105%) and the rest is
+ * stretched over the whole output with one of the usual kernels. The
+ * resampler is separable, horizontal pass first, with 14-bit fixed
+ * point weights so that the SSE2 and plain C versions give the same
+ * pixels, and the output rows are split between the threads of a pool.
+ * The weights are kept in an arena and only built again when the
+ * sizes, zoom or kernel change.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_SCALE_H
+#define TESTCARD_SCALE_H
+
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "arena.h"
+#include "pool.h"
+
+#define SCALE_NONE     0
+#define SCALE_NEAREST  1
+#define SCALE_BILINEAR 2
+#define SCALE_BICUBIC  3
+#define SCALE_LANCZOS  4
+#define SCALE_KERNELS  5
+
+// Kernel names for messages and options, indexed by SCALE_*.
+extern const char * const SCALE_NAME[SCALE_KERNELS];
+
+struct scale;
+
+// A scaler running on the threads of pool with its buffers in arena,
+// NULL when out of memory.
+struct scale *scaleCreate(struct pool *pool, struct arena *arena);
+
+// Give the buffers back to the arena.
+void scaleFree(struct scale *scale);
+
+// Resample all of src, zoomed in by zoom around its centre, to fill all
+// of dst. Both are 32 bits per pixel with the same pixel format.
+// Returns false when out of memory.
+bool scaleSurface(struct scale *scale, SDL_Surface *dst, SDL_Surface *src, double zoom, int kernel);
+
+#endif
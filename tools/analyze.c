@@ -0,0 +1,301 @@
+/*
+ * Test Card - Frame ID analyzer
+ *
+ * Reads a capture of the animated card drawn with "testcard -a -b",
+ * decodes the frame number of every frame from the code in the
+ * bottom-left corner (see frameid.h) and reports dropped, repeated and
+ * out of order frames. The input is a YUV4MPEG2 stream or raw frames
+ * of a given size and format, from a file or stdin so that it can be
+ * piped straight from a capture or decoder, e.g.
+ *
+ *   ffmpeg -i capture.mkv -f yuv4mpegpipe - | tools/analyze
+ *
+ * Only a few dozen luma samples are read from each frame so this keeps
+ * up with anything that can deliver the frames.
+ *
+ * Usage: analyze [-q] [-s <width>x<height> -p <format>] [<file>]
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../frameid.h"
+
+// How far back repeated and late frames are recognized
+#define HISTORY 4096
+
+// Where the luma of a frame is and how big a frame is.
+struct format {
+  const char *name;
+  // luma offset and distance between samples in bytes
+  int offset, step;
+  // bits per sample, above 8 samples are 16-bit little-endian
+  int depth;
+  // frame size in bytes for a w by h frame, NULL with YUV4MPEG2
+  size_t (*size)(int w, int h);
+};
+
+static size_t size420(int w, int h) { return (size_t)w*h + 2*(size_t)((w+1)/2)*((h+1)/2); }
+static size_t size420w(int w, int h) { return 2*size420(w, h); }
+static size_t size422(int w, int h) { return 2*(size_t)w*h; }
+static size_t size24(int w, int h) { return 3*(size_t)w*h; }
+static size_t size32(int w, int h) { return 4*(size_t)w*h; }
+
+// Raw formats, the green channel stands in for luma with RGB since the
+// code is black and white.
+static const struct format formats[] = {
+  {"i420",  0, 1,  8, size420},
+  {"nv12",  0, 1,  8, size420},
+  {"p010",  0, 2, 16, size420w},
+  {"yuyv",  0, 2,  8, size422},
+  {"uyvy",  1, 2,  8, size422},
+  {"rgb24", 1, 3,  8, size24},
+  {"bgra",  1, 4,  8, size32},
+};
+
+struct stream {
+  FILE *file;
+  bool y4m;
+  int w, h;
+  size_t frameSize;
+  struct format format;
+};
+
+// Parse the YUV4MPEG2 stream header, the magic has been read already.
+static bool readY4mHeader(struct stream *s)
+{
+  char line[1024];
+  if (!fgets(line, sizeof(line), s->file) || !strchr(line, '\n')) {
+    fprintf(stderr, "Invalid YUV4MPEG2 header\n");
+    return false;
+  }
+  const char *colorspace = "420";
+  for (char *p = strtok(line, " \n"); p; p = strtok(NULL, " \n")) {
+    switch (p[0]) {
+    case 'W': s->w = atoi(p + 1); break;
+    case 'H': s->h = atoi(p + 1); break;
+    case 'C': colorspace = p + 1; break;
+    default: break;
+    }
+  }
+  if (s->w <= 0 || s->h <= 0) {
+    fprintf(stderr, "Invalid YUV4MPEG2 frame size\n");
+    return false;
+  }
+
+  // e.g. 420jpeg, 422, 444p10, mono16
+  int depth = 8;
+  const char *bits = strchr(colorspace, 'p');
+  if (bits && bits[1] >= '0' && bits[1] <= '9') {
+    depth = atoi(bits + 1);
+  } else if (!strncmp(colorspace, "mono", 4) && colorspace[4]) {
+    depth = atoi(colorspace + 4);
+  }
+  size_t bytes = depth > 8 ? 2 : 1;
+  size_t luma = (size_t)s->w * s->h * bytes;
+  size_t chroma;
+  if (!strncmp(colorspace, "mono", 4)) {
+    chroma = 0;
+  } else if (!strncmp(colorspace, "444", 3)) {
+    chroma = 2 * luma + (strstr(colorspace, "alpha") ? luma : 0);
+  } else if (!strncmp(colorspace, "422", 3)) {
+    chroma = 2 * (size_t)((s->w+1)/2) * s->h * bytes;
+  } else if (!strncmp(colorspace, "411", 3)) {
+    chroma = 2 * (size_t)((s->w+3)/4) * s->h * bytes;
+  } else if (!strncmp(colorspace, "420", 3)) {
+    chroma = 2 * (size_t)((s->w+1)/2) * ((s->h+1)/2) * bytes;
+  } else {
+    fprintf(stderr, "Unsupported YUV4MPEG2 colorspace: C%s\n", colorspace);
+    return false;
+  }
+  s->format.name = "y4m";
+  s->format.offset = 0;
+  s->format.step = bytes;
+  s->format.depth = depth;
+  s->format.size = NULL;
+  s->frameSize = luma + chroma;
+  return true;
+}
+
+// Read the next frame into buf, returns false at the end of the stream.
+static bool readFrame(struct stream *s, uint8_t *buf)
+{
+  if (s->y4m) {
+    char line[256];
+    if (!fgets(line, sizeof(line), s->file)) return false;
+    if (strncmp(line, "FRAME", 5) || !strchr(line, '\n')) {
+      fprintf(stderr, "Invalid YUV4MPEG2 frame header\n");
+      return false;
+    }
+  }
+  size_t n = fread(buf, 1, s->frameSize, s->file);
+  if (n && n < s->frameSize) {
+    fprintf(stderr, "Truncated frame of %zu bytes at the end\n", n);
+  }
+  return n == s->frameSize;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "\n"
+          "Usage: %s [-q] [-s <width>x<height> -p <format>] [<file>]\n"
+          "\t-q\tOnly print the summary, not every dropped or repeated frame\n"
+          "\t-s\tSize of raw frames, needed unless the input is YUV4MPEG2\n"
+          "\t-p\tPixel format of raw frames: i420 (default), nv12, p010, yuyv, uyvy, rgb24 or bgra\n"
+          "\t<file>\tRead from a file instead of stdin\n"
+          "\n"
+          "Exits with 1 if any frame was dropped, repeated, out of order or unreadable.\n",
+          name);
+}
+
+int main(int argc, char **argv)
+{
+  bool quiet = false;
+  const char *fileName = NULL;
+  struct stream s = {NULL, false, 0, 0, 0, formats[0]};
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-q")) {
+      quiet = true;
+    } else if (!strcmp(argv[i], "-s") && i+1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &s.w, &s.h) != 2 || s.w <= 0 || s.h <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (!strcmp(argv[i], "-p") && i+1 < argc) {
+      ++i;
+      unsigned k = 0;
+      for (; k < sizeof(formats)/sizeof(formats[0]); ++k) {
+        if (!strcmp(argv[i], formats[k].name)) break;
+      }
+      if (k == sizeof(formats)/sizeof(formats[0])) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      s.format = formats[k];
+    } else if (argv[i][0] != '-' && !fileName) {
+      fileName = argv[i];
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  s.file = fileName ? fopen(fileName, "rb") : stdin;
+  if (!s.file) {
+    perror(fileName);
+    return EXIT_FAILURE;
+  }
+
+  // YUV4MPEG2 is recognized by its magic, anything else is raw
+  char magic[10];
+  size_t n = fread(magic, 1, 9, s.file);
+  bool raw = n < 9 || memcmp(magic, "YUV4MPEG2", 9);
+  if (!raw) {
+    s.y4m = true;
+    if (!readY4mHeader(&s)) return EXIT_FAILURE;
+  } else if (!s.w) {
+    fprintf(stderr, "Not a YUV4MPEG2 stream, give the size of the raw frames with -s\n");
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  } else {
+    s.frameSize = s.format.size(s.w, s.h);
+  }
+
+  struct frameIdLayout layout;
+  if (!frameIdLayout(s.w, s.h, &layout)) {
+    fprintf(stderr, "Frames of %dx%d are too small for a frame ID\n", s.w, s.h);
+    return EXIT_FAILURE;
+  }
+
+  uint8_t *buf = malloc(s.frameSize);
+  if (!buf) {
+    fprintf(stderr, "malloc: Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  // the magic of a raw stream was the start of the first frame
+  size_t have = raw ? n : 0;
+  if (have) memcpy(buf, magic, have);
+
+  static uint32_t seen[HISTORY];
+  static bool seenValid[HISTORY];
+  uint64_t frames = 0, identified = 0, missing = 0, badCrc = 0;
+  uint64_t dropped = 0, repeated = 0, outOfOrder = 0;
+  uint32_t first = 0, last = 0, highest = 0;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (;;) {
+    if (have) {
+      bool complete = fread(buf + have, 1, s.frameSize - have, s.file) == s.frameSize - have;
+      have = 0;
+      if (!complete) break;
+    } else if (!readFrame(&s, buf)) {
+      break;
+    }
+
+    uint32_t id;
+    int result = frameIdDecode(&layout, buf + s.format.offset, s.w * s.format.step,
+                               s.format.step, s.format.depth, &id);
+    uint64_t index = frames++;
+    if (result == FRAMEID_MISSING) {
+      ++missing;
+      if (!quiet) printf("frame %llu: no frame ID\n", (unsigned long long)index);
+      continue;
+    }
+    if (result == FRAMEID_BADCRC) {
+      ++badCrc;
+      if (!quiet) printf("frame %llu: frame ID fails CRC\n", (unsigned long long)index);
+      continue;
+    }
+
+    if (!identified++) {
+      first = highest = id;
+    } else if (id == last) {
+      ++repeated;
+      if (!quiet) printf("frame %llu: %u repeated\n", (unsigned long long)index, id);
+    } else if ((int32_t)(id - highest) > 0) {
+      uint32_t gap = id - highest - 1;
+      if (gap) {
+        dropped += gap;
+        if (!quiet) printf("frame %llu: %u dropped before %u\n", (unsigned long long)index, gap, id);
+      }
+      highest = id;
+    } else if (highest - id < HISTORY && seenValid[id % HISTORY] && seen[id % HISTORY] == id) {
+      ++repeated;
+      if (!quiet) printf("frame %llu: %u repeated late\n", (unsigned long long)index, id);
+    } else {
+      // counted as dropped when the later frames came first
+      ++outOfOrder;
+      if (highest - id < HISTORY && dropped) --dropped;
+      if (!quiet) printf("frame %llu: %u out of order after %u\n", (unsigned long long)index, id, last);
+    }
+    seen[id % HISTORY] = id;
+    seenValid[id % HISTORY] = true;
+    last = id;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("%llu frames of %dx%d %s in %.2f s (%.1f fps)\n", (unsigned long long)frames,
+         s.w, s.h, s.format.name, seconds, seconds > 0 ? frames / seconds : 0.);
+  if (identified) {
+    printf("frame IDs %u to %u\n", first, highest);
+  }
+  printf("%llu identified, %llu without a frame ID, %llu failing CRC\n",
+         (unsigned long long)identified, (unsigned long long)missing, (unsigned long long)badCrc);
+  printf("%llu dropped, %llu repeated, %llu out of order\n",
+         (unsigned long long)dropped, (unsigned long long)repeated, (unsigned long long)outOfOrder);
+
+  free(buf);
+  if (fileName) fclose(s.file);
+  return dropped || repeated || outOfOrder || missing || badCrc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,427 @@
+/*
+ * Test Card - Golden hashes of card sets
+ *
+ * Renders every combination of chroma mode, deinterlacer and display
+ * scaler at each resolution given with libtestcard (see card.h) and
+ * hashes the pixels of each region of the layout, the rows of the card
+ * and the borders, and of the whole image. The cards are rendered and
+ * hashed in memory on one thread per CPU, one render context each,
+ * and no image is written.
+ *
+ * With -o the hashes are written to a manifest, one card per line. With
+ * -c the cards of a manifest are rendered again and compared with it,
+ * and every card that changed is reported with the regions that did,
+ * so that a sweep after an upgrade proves the pixels are the same
+ * without keeping the images around.
+ *
+ * Usage: cardhash [-j <threads>] -o <manifest> [<width>x<height> ...]
+ *        cardhash [-j <threads>] -c <manifest>
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <SDL.h>
+
+#include "../card.h"
+
+#define MAX_THREADS 32
+#define MAX_LINE 1024
+
+// Resolutions hashed when none are given
+static const int defaultSizes[][2] = {
+  {640, 480}, {720, 480}, {720, 576}, {800, 600}, {1024, 768},
+  {1280, 720}, {1280, 1024}, {1366, 768}, {1920, 1080},
+};
+
+struct job {
+  int width, height;
+  int mode, fields, scaler;
+  // the regions and then the image, the manifest's for -c
+  uint64_t hash[CARD_REGIONS + 1];
+  uint64_t expected[CARD_REGIONS + 1];
+  int error;
+  bool uncovered;
+};
+
+struct worker {
+  SDL_Thread *thread;
+  struct card *card;
+  Uint32 *pixels;
+  size_t size;
+};
+
+static struct job *jobs;
+static int jobCount, nextJob;
+
+// FNV-1a on whole pixels in four lanes so that the multiplies of
+// neighbouring pixels overlap, the unused top byte left out.
+static uint64_t hashRect(const Uint32 *pixels, int pitch, SDL_Rect r)
+{
+  const uint64_t prime = 1099511628211ull;
+  uint64_t h[4] = {14695981039346656037ull, 1, 2, 3};
+  for (int j = 0; j < r.h; ++j) {
+    const Uint32 *p = pixels + (size_t)(r.y + j) * pitch + r.x;
+    int i = 0;
+    for (; i + 4 <= r.w; i += 4) {
+      h[0] = (h[0] ^ (p[i] & 0xffffff)) * prime;
+      h[1] = (h[1] ^ (p[i+1] & 0xffffff)) * prime;
+      h[2] = (h[2] ^ (p[i+2] & 0xffffff)) * prime;
+      h[3] = (h[3] ^ (p[i+3] & 0xffffff)) * prime;
+    }
+    for (; i < r.w; ++i) {
+      h[0] = (h[0] ^ (p[i] & 0xffffff)) * prime;
+    }
+  }
+  uint64_t hash = h[0];
+  for (int k = 1; k < 4; ++k) {
+    hash = (hash ^ h[k]) * prime;
+  }
+  return (hash ^ ((uint64_t)r.w << 32 | (Uint32)r.h)) * prime;
+}
+
+// Whether the regions are inside the card, apart and add up to it, so
+// that every pixel is hashed exactly once.
+static bool coversCard(const SDL_Rect *regions, int width, int height)
+{
+  uint64_t area = 0;
+  for (int i = 0; i < CARD_REGIONS; ++i) {
+    const SDL_Rect *a = &regions[i];
+    if (a->x < 0 || a->y < 0 ||
+        a->x + a->w > width || a->y + a->h > height) {
+      return false;
+    }
+    area += (uint64_t)a->w * a->h;
+    for (int j = 0; j < i; ++j) {
+      const SDL_Rect *b = &regions[j];
+      if (a->w && a->h && b->w && b->h && a->x < b->x + b->w && b->x < a->x + a->w &&
+          a->y < b->y + b->h && b->y < a->y + a->h) {
+        return false;
+      }
+    }
+  }
+  return area == (uint64_t)width * height;
+}
+
+static void label(const struct job *job, char *text)
+{
+  struct cardOptions o;
+  cardDefaults(&o);
+  o.fields = job->fields;
+  o.scaler = job->scaler;
+  char l[CARD_LABEL];
+  cardLabel(&o, CARD_MODE_NAME[job->mode], l);
+  sprintf(text, "%dx%d %s", job->width, job->height, l);
+}
+
+// Render and hash the jobs nobody has taken yet.
+static int work(void *data)
+{
+  struct worker *w = data;
+  for (;;) {
+    int n = __atomic_fetch_add(&nextJob, 1, __ATOMIC_RELAXED);
+    if (n >= jobCount) break;
+    struct job *job = &jobs[n];
+    size_t size = (size_t)job->width * job->height;
+    if (size > w->size) {
+      free(w->pixels);
+      w->pixels = calloc(size, sizeof(Uint32));
+      w->size = w->pixels ? size : 0;
+      if (!w->pixels) {
+        job->error = CARD_NOMEM;
+        continue;
+      }
+    }
+
+    struct cardOptions o;
+    cardDefaults(&o);
+    o.mode = job->mode;
+    o.fields = job->fields;
+    o.scaler = job->scaler;
+    struct cardBuffer buffer = {w->pixels, 4 * job->width, 0xff0000, 0xff00, 0xff,
+                                job->width, job->height, 0, 0, 0, 0};
+    job->error = cardRender(w->card, &o, &buffer);
+    if (job->error) continue;
+
+    // the regions cover the card, so they make up the image hash
+    SDL_Rect regions[CARD_REGIONS];
+    cardRegions(job->width, job->height, regions);
+    if (!coversCard(regions, job->width, job->height)) {
+      job->uncovered = true;
+      continue;
+    }
+    uint64_t image = 14695981039346656037ull;
+    for (int i = 0; i < CARD_REGIONS; ++i) {
+      job->hash[i] = hashRect(w->pixels, job->width, regions[i]);
+      image = (image ^ job->hash[i]) * 1099511628211ull;
+    }
+    job->hash[CARD_REGIONS] = image;
+  }
+  return 0;
+}
+
+static bool run(int threads)
+{
+  struct worker workers[MAX_THREADS];
+  memset(workers, 0, sizeof(workers));
+  if (threads > jobCount) threads = jobCount;
+  if (threads < 1) threads = 1;
+  // contexts are made on this thread, SDL_ttf is not thread safe
+  for (int i = 0; i < threads; ++i) {
+    int error;
+    workers[i].card = cardCreate(NULL, 1, 0, &error);
+    if (!workers[i].card) {
+      fprintf(stderr, "cardCreate: %s\n", cardError(error));
+      threads = i;
+      break;
+    }
+  }
+  for (int i = 1; i < threads; ++i) {
+    workers[i].thread = SDL_CreateThread(work, &workers[i]);
+  }
+  if (threads) work(&workers[0]);
+  for (int i = 1; i < threads; ++i) {
+    if (workers[i].thread) SDL_WaitThread(workers[i].thread, NULL);
+  }
+  for (int i = 0; i < threads; ++i) {
+    cardFree(workers[i].card);
+    free(workers[i].pixels);
+  }
+  if (!threads) return false;
+
+  bool ok = true;
+  for (int n = 0; n < jobCount; ++n) {
+    if (jobs[n].error || jobs[n].uncovered) {
+      char text[MAX_LINE];
+      label(&jobs[n], text);
+      if (jobs[n].error) {
+        fprintf(stderr, "%s: cardRender: %s\n", text, cardError(jobs[n].error));
+      } else {
+        fprintf(stderr, "%s: The regions do not cover the card\n", text);
+      }
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static bool addJob(int width, int height, int mode, int fields, int scaler)
+{
+  if ((jobCount & 255) == 0) {
+    struct job *j = realloc(jobs, (jobCount + 256) * sizeof(*jobs));
+    if (!j) {
+      fprintf(stderr, "Out of memory\n");
+      return false;
+    }
+    jobs = j;
+  }
+  struct job *job = &jobs[jobCount++];
+  memset(job, 0, sizeof(*job));
+  job->width = width;
+  job->height = height;
+  job->mode = mode;
+  job->fields = fields;
+  job->scaler = scaler;
+  return true;
+}
+
+// A line of the manifest, e.g. "1920x1080 mode=4 fields=2 scaler=0
+// image=... colorbars=... ..." with the hashes in hex.
+static bool parseLine(char *line)
+{
+  int width, height, mode, fields, scaler, n;
+  if (sscanf(line, "%dx%d mode=%d fields=%d scaler=%d%n", &width, &height, &mode, &fields, &scaler, &n) != 5 ||
+      width <= 0 || height <= 0 || width > CARD_MAX || height > CARD_MAX ||
+      mode < 0 || mode >= CARD_MODES || fields < 0 || fields >= FIELDS_METHODS ||
+      scaler < 0 || scaler >= SCALE_KERNELS || !addJob(width, height, mode, fields, scaler)) {
+    return false;
+  }
+  struct job *job = &jobs[jobCount - 1];
+  bool found[CARD_REGIONS + 1] = {false};
+  for (char *p = strtok(line + n, " \n"); p; p = strtok(NULL, " \n")) {
+    char *value = strchr(p, '=');
+    if (!value) return false;
+    *value++ = 0;
+    int i = 0;
+    while (i < CARD_REGIONS && strcmp(p, CARD_REGION_NAME[i])) ++i;
+    if (i == CARD_REGIONS && strcmp(p, "image")) return false;
+    unsigned long long hash;
+    if (sscanf(value, "%16llx", &hash) != 1) return false;
+    job->expected[i] = hash;
+    found[i] = true;
+  }
+  for (int i = 0; i <= CARD_REGIONS; ++i) {
+    if (!found[i]) return false;
+  }
+  return true;
+}
+
+static bool readManifest(const char *fileName)
+{
+  FILE *f = fopen(fileName, "r");
+  if (!f) {
+    perror(fileName);
+    return false;
+  }
+  char line[MAX_LINE];
+  int number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    ++number;
+    if (line[0] == '#' || line[0] == '\n') continue;
+    if (!parseLine(line)) {
+      fprintf(stderr, "%s:%d: Invalid manifest line\n", fileName, number);
+      ok = false;
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+static bool writeManifest(const char *fileName)
+{
+  FILE *f = strcmp(fileName, "-") ? fopen(fileName, "w") : stdout;
+  if (!f) {
+    perror(fileName);
+    return false;
+  }
+  fprintf(f, "# Test Card golden hashes, see tools/cardhash.c\n");
+  for (int n = 0; n < jobCount; ++n) {
+    const struct job *job = &jobs[n];
+    fprintf(f, "%dx%d mode=%d fields=%d scaler=%d image=%016llx", job->width, job->height,
+            job->mode, job->fields, job->scaler, (unsigned long long)job->hash[CARD_REGIONS]);
+    for (int i = 0; i < CARD_REGIONS; ++i) {
+      fprintf(f, " %s=%016llx", CARD_REGION_NAME[i], (unsigned long long)job->hash[i]);
+    }
+    fprintf(f, "\n");
+  }
+  bool ok = !ferror(f);
+  if (f != stdout && fclose(f)) ok = false;
+  if (!ok) perror(fileName);
+  return ok;
+}
+
+// Report the cards that changed and the regions where. Returns how
+// many did.
+static int compare(void)
+{
+  int changed = 0;
+  for (int n = 0; n < jobCount; ++n) {
+    const struct job *job = &jobs[n];
+    if (!memcmp(job->hash, job->expected, sizeof(job->hash))) continue;
+    ++changed;
+    char text[MAX_LINE];
+    label(job, text);
+    SDL_Rect regions[CARD_REGIONS];
+    cardRegions(job->width, job->height, regions);
+    bool named = false;
+    for (int i = 0; i < CARD_REGIONS; ++i) {
+      if (job->hash[i] == job->expected[i]) continue;
+      printf("%s: %s changed at %d,%d %dx%d\n", text, CARD_REGION_NAME[i],
+             regions[i].x, regions[i].y, regions[i].w, regions[i].h);
+      named = true;
+    }
+    if (!named) {
+      // only a manifest edited by hand gets here
+      printf("%s: image changed\n", text);
+    }
+  }
+  return changed;
+}
+
+static double now(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "\n"
+          "Usage: %s [-j <threads>] -o <manifest> [<width>x<height> ...]\n"
+          "       %s [-j <threads>] -c <manifest>\n"
+          "\t-o\tWrite the hashes of every mode, deinterlacer and scaler at the given\n"
+          "\t\tresolutions, common ones by default, to <manifest>, - for stdout\n"
+          "\t-c\tRender the cards of <manifest> again and report the regions that changed\n"
+          "\t-j\tRender on this many threads, default one per CPU\n"
+          "\n"
+          "Exits with 1 if a card changed.\n",
+          name, name);
+}
+
+int main(int argc, char **argv)
+{
+  const char *output = NULL, *check = NULL;
+  int threads = 0;
+  int sizes = 0;
+  for (int i = 1; i < argc; ++i) {
+    int width, height;
+    if (!strcmp(argv[i], "-o") && i+1 < argc) {
+      output = argv[++i];
+    } else if (!strcmp(argv[i], "-c") && i+1 < argc) {
+      check = argv[++i];
+    } else if (!strcmp(argv[i], "-j") && i+1 < argc) {
+      if (sscanf(argv[++i], "%d", &threads) != 1 || threads <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (argv[i][0] != '-' && sscanf(argv[i], "%dx%d", &width, &height) == 2 &&
+               width > 0 && height > 0 && width <= CARD_MAX && height <= CARD_MAX) {
+      ++sizes;
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (!output == !check || (check && sizes)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (!threads) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = n > 0 ? n : 1;
+  }
+  if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+  if (check) {
+    if (!readManifest(check)) return EXIT_FAILURE;
+  } else {
+    // one size after the other, so the contexts mostly keep their buffers
+    int count = sizes ? sizes : (int)(sizeof(defaultSizes) / sizeof(defaultSizes[0]));
+    for (int s = 0, i = 1; s < count; ++s) {
+      int width = defaultSizes[s][0], height = defaultSizes[s][1];
+      if (sizes) {
+        while (argv[i][0] == '-') i += 2;
+        sscanf(argv[i++], "%dx%d", &width, &height);
+      }
+      for (int mode = 0; mode < CARD_MODES; ++mode) {
+        for (int fields = 0; fields < FIELDS_METHODS; ++fields) {
+          for (int scaler = 0; scaler < SCALE_KERNELS; ++scaler) {
+            if (!addJob(width, height, mode, fields, scaler)) return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+  }
+
+  double start = now();
+  if (!run(threads)) return EXIT_FAILURE;
+  double seconds = now() - start;
+
+  if (output) {
+    if (!writeManifest(output)) return EXIT_FAILURE;
+    fprintf(stderr, "%d cards hashed in %.2f s on %d threads\n", jobCount, seconds, threads);
+    return EXIT_SUCCESS;
+  }
+  int changed = compare();
+  printf("%d cards checked in %.2f s on %d threads, %d changed\n", jobCount, seconds, threads, changed);
+  return changed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
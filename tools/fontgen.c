@@ -0,0 +1,296 @@
+/*
+ * Test Card - Signed distance field font atlas generator
+ *
+ * Rasterizes the glyphs of a TrueType font with SDL_ttf at a large
+ * size, computes an exact euclidean distance transform of each glyph
+ * and writes the downsampled signed distance fields, along with the
+ * metrics needed to lay out text, as a C header on stdout. The
+ * Makefile runs this at build time on Vera.ttf so that the test card
+ * itself can draw text at any size without opening a font file.
+ *
+ * Usage: fontgen <font.ttf> > vera_sdf.h
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+// Glyphs are rasterized at EM pixels and the distance field is stored
+// at 1/DOWN of that, with SPREAD atlas pixels of distance range on
+// both sides of the outline.
+#define EM     160
+#define DOWN   4
+#define SPREAD 6
+
+#define FIRST_LOW  0x20
+#define LAST_LOW   0x7e
+#define FIRST_HIGH 0xa0
+#define LAST_HIGH  0xff
+
+struct glyph {
+  int code;
+  int advance;
+  int x, y;
+  int w, h;
+  int offset;
+};
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static inline int saturatei(int a, const int min, const int max)
+{
+  if (a < min) return min;
+  if (a > max) return max;
+  return a;
+}
+
+// One dimensional squared distance transform (Felzenszwalb &
+// Huttenlocher) of f with n samples, result in d. v and z are scratch
+// arrays of n and n+1 elements.
+static void edt1d(const double *f, double *d, int n, int *v, double *z)
+{
+  int k = 0;
+  v[0] = 0;
+  z[0] = -HUGE_VAL;
+  z[1] = HUGE_VAL;
+  for (int q = 1; q < n; ++q) {
+    double s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k])) / (2*q - 2*v[k]);
+    while (s <= z[k]) {
+      --k;
+      s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k])) / (2*q - 2*v[k]);
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k+1] = HUGE_VAL;
+  }
+  k = 0;
+  for (int q = 0; q < n; ++q) {
+    while (z[k+1] < q) ++k;
+    d[q] = (q - v[k])*(q - v[k]) + f[v[k]];
+  }
+}
+
+// Squared distance from every pixel to the nearest pixel where
+// inside[] equals target, in place on a w*h grid.
+static void edt2d(const bool *inside, bool target, double *grid, int w, int h)
+{
+  int n = maxi(w, h);
+  double *f = calloc(n, sizeof(double));
+  double *d = malloc(n * sizeof(double));
+  double *z = malloc((n+1) * sizeof(double));
+  int *v = malloc(n * sizeof(int));
+  if (!f || !d || !z || !v) {
+    fprintf(stderr, "malloc: Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = 0; i < w*h; ++i) {
+    grid[i] = inside[i] == target ? 0 : 1e20;
+  }
+  for (int i = 0; i < w; ++i) {
+    for (int j = 0; j < h; ++j) f[j] = grid[j*w + i];
+    edt1d(f, d, h, v, z);
+    for (int j = 0; j < h; ++j) grid[j*w + i] = d[j];
+  }
+  for (int j = 0; j < h; ++j) {
+    edt1d(grid + j*w, d, w, v, z);
+    memcpy(grid + j*w, d, w * sizeof(double));
+  }
+
+  free(f);
+  free(d);
+  free(z);
+  free(v);
+}
+
+// Render one glyph and append its distance field to atlas. Glyphs
+// missing from the font get an empty entry so that the table can be
+// indexed directly by code point.
+static void makeGlyph(TTF_Font *font, int code, struct glyph *g, Uint8 **atlas, int *size)
+{
+  g->code = code;
+  g->advance = 0;
+  g->x = g->y = g->w = g->h = 0;
+  g->offset = *size;
+
+  int minx, maxx, miny, maxy, advance;
+  if (TTF_GlyphMetrics(font, code, &minx, &maxx, &miny, &maxy, &advance)) {
+    return;
+  }
+  g->advance = advance;
+
+  char buf[4] = {0};
+  if (code < 0x80) {
+    buf[0] = code;
+  } else {
+    buf[0] = 0xc0 | (code >> 6);
+    buf[1] = 0x80 | (code & 0x3f);
+  }
+
+  SDL_Color white = {255, 255, 255, 0};
+  SDL_Surface *text = code == ' ' ? NULL : TTF_RenderUTF8_Blended(font, buf, white);
+  if (!text) {
+    return;
+  }
+
+  // SDL_ttf shifts the pen right when the first glyph has a negative
+  // left bearing.
+  int originx = maxi(0, -minx);
+
+  SDL_LockSurface(text);
+  int x0 = text->w, y0 = text->h, x1 = -1, y1 = -1;
+  bool *mask = malloc(text->w * text->h * sizeof(bool));
+  if (!mask) {
+    fprintf(stderr, "malloc: Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int j = 0; j < text->h; ++j) {
+    for (int i = 0; i < text->w; ++i) {
+      Uint8 *p = (Uint8 *)text->pixels + j*text->pitch + i*text->format->BytesPerPixel;
+      Uint32 pixel = 0;
+      memcpy(&pixel, p, text->format->BytesPerPixel);
+      Uint8 r, gg, b, a;
+      SDL_GetRGBA(pixel, text->format, &r, &gg, &b, &a);
+      mask[j*text->w + i] = a >= 128;
+      if (a) {
+        x0 = mini(x0, i);
+        y0 = mini(y0, j);
+        x1 = maxi(x1, i);
+        y1 = maxi(y1, j);
+      }
+    }
+  }
+  SDL_UnlockSurface(text);
+
+  if (x1 < 0) {
+    free(mask);
+    SDL_FreeSurface(text);
+    return;
+  }
+
+  // padded region, a whole number of atlas pixels in size
+  int pad = SPREAD * DOWN;
+  int gw = (x1 - x0 + 1 + 2*pad + DOWN-1) / DOWN;
+  int gh = (y1 - y0 + 1 + 2*pad + DOWN-1) / DOWN;
+  int rx = x0 - pad, ry = y0 - pad;
+  int rw = gw * DOWN, rh = gh * DOWN;
+
+  bool *inside = calloc(rw * rh, sizeof(bool));
+  double *din = malloc(rw * rh * sizeof(double));
+  double *dout = malloc(rw * rh * sizeof(double));
+  Uint8 *out = realloc(*atlas, *size + gw*gh);
+  if (!inside || !din || !dout || !out) {
+    fprintf(stderr, "malloc: Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  *atlas = out;
+
+  for (int j = 0; j < rh; ++j) {
+    for (int i = 0; i < rw; ++i) {
+      int sx = rx + i, sy = ry + j;
+      if (sx >= 0 && sy >= 0 && sx < text->w && sy < text->h) {
+        inside[j*rw + i] = mask[sy*text->w + sx];
+      }
+    }
+  }
+  edt2d(inside, false, din, rw, rh);
+  edt2d(inside, true, dout, rw, rh);
+
+  for (int j = 0; j < gh; ++j) {
+    for (int i = 0; i < gw; ++i) {
+      double sum = 0;
+      for (int v = 0; v < DOWN; ++v) {
+        for (int u = 0; u < DOWN; ++u) {
+          int k = (j*DOWN + v)*rw + i*DOWN + u;
+          sum += inside[k] ? sqrt(din[k]) - 0.5 : 0.5 - sqrt(dout[k]);
+        }
+      }
+      double d = sum / (DOWN*DOWN) / DOWN;
+      out[*size + j*gw + i] = saturatei(lround(128 + d * 127 / SPREAD), 0, 255);
+    }
+  }
+
+  g->x = rx - originx;
+  g->y = ry;
+  g->w = gw;
+  g->h = gh;
+  *size += gw*gh;
+
+  free(inside);
+  free(din);
+  free(dout);
+  free(mask);
+  SDL_FreeSurface(text);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <font.ttf>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (TTF_Init()) {
+    fprintf(stderr, "TTF_Init: %s\n", TTF_GetError());
+    return EXIT_FAILURE;
+  }
+  TTF_Font *font = TTF_OpenFont(argv[1], EM);
+  if (!font) {
+    fprintf(stderr, "TTF_OpenFont: %s\n", TTF_GetError());
+    return EXIT_FAILURE;
+  }
+  TTF_SetFontKerning(font, 0);
+
+  struct glyph glyphs[(LAST_LOW-FIRST_LOW+1) + (LAST_HIGH-FIRST_HIGH+1)];
+  int count = 0;
+  Uint8 *atlas = NULL;
+  int size = 0;
+  for (int c = FIRST_LOW; c <= LAST_HIGH; ++c) {
+    if (c > LAST_LOW && c < FIRST_HIGH) continue;
+    makeGlyph(font, c, &glyphs[count++], &atlas, &size);
+  }
+
+  printf("/* Generated by tools/fontgen from %s - do not edit */\n\n", argv[1]);
+  printf("#define SDF_EM      %d\n", EM);
+  printf("#define SDF_DOWN    %d\n", DOWN);
+  printf("#define SDF_SPREAD  %d\n", SPREAD);
+  printf("#define SDF_ASCENT  %d\n", TTF_FontAscent(font));
+  printf("#define SDF_DESCENT %d\n", TTF_FontDescent(font));
+  printf("#define SDF_LINESKIP %d\n", TTF_FontLineSkip(font));
+  printf("#define SDF_GLYPHS  %d\n\n", count);
+
+  printf("static const struct sdfGlyph sdfGlyphs[SDF_GLYPHS] = {\n");
+  for (int i = 0; i < count; ++i) {
+    struct glyph *g = &glyphs[i];
+    printf("  {0x%02x, %d, %d, %d, %d, %d, %d},\n",
+           g->code, g->advance, g->x, g->y, g->w, g->h, g->offset);
+  }
+  printf("};\n\n");
+
+  printf("static const Uint8 sdfAtlas[%d] = {", size);
+  for (int i = 0; i < size; ++i) {
+    printf(i % 20 ? "%d," : "\n  %d,", atlas[i]);
+  }
+  printf("\n};\n");
+
+  free(atlas);
+  TTF_CloseFont(font);
+  TTF_Quit();
+  return EXIT_SUCCESS;
+}
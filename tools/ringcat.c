@@ -0,0 +1,178 @@
+/*
+ * Test Card - Shared memory frame ring reader
+ *
+ * A reference reader of the frames "testcard -m <name>" publishes (see
+ * ring.h) and a test of the ring itself. Every new frame is read in
+ * place in the shared memory, without copying it: the line printed for
+ * it has its size, pixel format and mode, a checksum of its pixels, the
+ * frame ID decoded from it if there is one (testcard -a -b) and how
+ * long after it was published it was read. The checksum is only
+ * printed once the sequence counter shows the frame was not overwritten
+ * while it was being summed.
+ *
+ * Usage: ringcat [-q] [-n <frames>] <name>
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../frameid.h"
+#include "../ring.h"
+
+// How long to sleep when there is no new frame
+#define POLL_NS 500000
+
+static volatile sig_atomic_t stop;
+
+static void interrupt(int signal)
+{
+  (void)signal;
+  stop = 1;
+}
+
+static uint64_t now(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// FNV-1a of the visible bytes of every row
+static uint32_t checksum(const struct ringFrame *f, const uint8_t *row)
+{
+  uint32_t hash = 2166136261u;
+  size_t n = (size_t)f->width * f->bytesPerPixel;
+  for (uint32_t j = 0; j < f->height; ++j, row += f->pitch) {
+    for (size_t i = 0; i < n; ++i) {
+      hash = (hash ^ row[i]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+// Where the green channel of a pixel is, it stands in for luma since
+// the frame ID is black and white.
+static int greenOffset(const struct ringFrame *f)
+{
+  int shift = 0;
+  while (shift < 32 && !((f->gmask >> shift) & 1)) ++shift;
+  const uint16_t one = 1;
+  bool little = *(const uint8_t *)&one;
+  return little ? shift / 8 : (int)f->bytesPerPixel - 1 - shift / 8;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "\n"
+          "Usage: %s [-q] [-n <frames>] <name>\n"
+          "\t-q\tOnly print the summary, not every frame\n"
+          "\t-n\tStop after reading this many frames, default when interrupted\n"
+          "\t<name>\tShared memory ring given to testcard -m, e.g. /testcard\n"
+          "\n"
+          "Exits with 1 if a frame ID does not match the frame number published with it.\n",
+          name);
+}
+
+int main(int argc, char **argv)
+{
+  bool quiet = false;
+  uint64_t count = 0;
+  const char *name = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-q")) {
+      quiet = true;
+    } else if (!strcmp(argv[i], "-n") && i+1 < argc) {
+      if (sscanf(argv[++i], "%llu", (unsigned long long *)&count) != 1 || !count) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (argv[i][0] != '-' && !name) {
+      name = argv[i];
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (!name) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct ring *ring = ringOpen(name);
+  if (!ring) return EXIT_FAILURE;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = interrupt;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  // start with the latest frame, the card may be still
+  uint64_t next = ringPublished(ring);
+  if (next) --next;
+  uint64_t frames = 0, missed = 0, overwritten = 0, mismatched = 0;
+  uint64_t first = now();
+
+  while (!stop && (!count || frames < count)) {
+    uint64_t published = ringPublished(ring);
+    if (next >= published) {
+      struct timespec t = {0, POLL_NS};
+      nanosleep(&t, NULL);
+      continue;
+    }
+    if (published - next > RING_SLOTS - 1) {
+      // those have been or are about to be overwritten
+      missed += published - 1 - next;
+      next = published - 1;
+    }
+
+    struct ringFrame f;
+    const uint8_t *pixels = ringBegin(ring, next, &f);
+    if (!pixels) {
+      ++missed;
+      ++next;
+      continue;
+    }
+    uint64_t latency = now() - f.time;
+    uint32_t hash = checksum(&f, pixels);
+    uint32_t id = 0;
+    struct frameIdLayout layout;
+    int result = FRAMEID_MISSING;
+    if (f.bytesPerPixel == 4 && frameIdLayout(f.width, f.height, &layout)) {
+      result = frameIdDecode(&layout, pixels + greenOffset(&f), f.pitch, 4, 8, &id);
+    }
+    bool match = result != FRAMEID_OK || id == (uint32_t)f.number;
+    if (!ringEnd(ring, next)) {
+      ++overwritten;
+      if (!quiet) printf("frame %llu: overwritten while read\n", (unsigned long long)next);
+      ++next;
+      continue;
+    }
+
+    ++frames;
+    if (!match) ++mismatched;
+    if (!quiet) {
+      printf("frame %llu: %ux%u %08x/%08x/%08x %s #%llu checksum %08x",
+             (unsigned long long)next, f.width, f.height, f.rmask, f.gmask, f.bmask, f.mode,
+             (unsigned long long)f.number, hash);
+      if (result == FRAMEID_OK) printf(" ID %u%s", id, match ? "" : " MISMATCH");
+      printf(" after %.2f ms\n", latency / 1e6);
+    }
+    ++next;
+  }
+
+  double seconds = (now() - first) / 1e9;
+  printf("%llu frames read in %.2f s, %llu missed, %llu overwritten while read, %llu with a wrong frame ID\n",
+         (unsigned long long)frames, seconds, (unsigned long long)missed,
+         (unsigned long long)overwritten, (unsigned long long)mismatched);
+  ringClose(ring);
+  return mismatched ? EXIT_FAILURE : EXIT_SUCCESS;
+}
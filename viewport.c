@@ -0,0 +1,230 @@
+/*
+ * Test Card - Pan and zoom viewport for cards bigger than the screen
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "viewport.h"
+
+// Rows rendered below each tile so that what looks at the next lines,
+// the deinterlacer and interlaced 4:2:0 chroma, sees the real ones
+#define MARGIN 4
+
+struct tile {
+  // tile column and row, -1 when free
+  int tx, ty;
+  // when it was last drawn, 0 when free
+  Uint32 used;
+  SDL_Surface *surface;
+};
+
+struct viewport {
+  int w, h;
+  // card position in screen pixels, negative to center a card smaller
+  // than the screen
+  int x, y, zoom;
+  int screenW, screenH;
+  Uint32 Rmask, Gmask, Bmask, Amask;
+  viewportRender render;
+  void *data;
+  struct tile *tiles;
+  int capacity;
+  Uint32 clock;
+};
+
+static inline int maxi(int a, int b)
+{
+  return a < b ? b : a;
+}
+
+static inline int mini(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+struct viewport *viewportCreate(int w, int h, const SDL_Surface *screen, viewportRender render, void *data)
+{
+  struct viewport *view = calloc(1, sizeof(*view));
+  if (!view) return NULL;
+  view->w = w;
+  view->h = h;
+  view->zoom = 1;
+  view->screenW = screen->w;
+  view->screenH = screen->h;
+  view->Rmask = screen->format->Rmask;
+  view->Gmask = screen->format->Gmask;
+  view->Bmask = screen->format->Bmask;
+  view->Amask = screen->format->Amask;
+  view->render = render;
+  view->data = data;
+
+  // twice what a screen at 1:1 can show, partial tiles on both sides
+  int columns = (screen->w + VIEWPORT_TILE - 1) / VIEWPORT_TILE + 1;
+  int rows = (screen->h + VIEWPORT_TILE - 1) / VIEWPORT_TILE + 1;
+  view->capacity = 2 * columns * rows;
+  view->tiles = calloc(view->capacity, sizeof(*view->tiles));
+  if (!view->tiles) {
+    free(view);
+    return NULL;
+  }
+  viewportInvalidate(view);
+  return view;
+}
+
+void viewportFree(struct viewport *view)
+{
+  if (!view) return;
+  for (int i = 0; i < view->capacity; ++i) {
+    SDL_FreeSurface(view->tiles[i].surface);
+  }
+  free(view->tiles);
+  free(view);
+}
+
+void viewportInvalidate(struct viewport *view)
+{
+  for (int i = 0; i < view->capacity; ++i) {
+    view->tiles[i].tx = view->tiles[i].ty = -1;
+    view->tiles[i].used = 0;
+  }
+}
+
+// Keep the card on the screen, centered when it is smaller.
+static void clamp(struct viewport *view)
+{
+  int w = view->w * view->zoom, h = view->h * view->zoom;
+  view->x = w <= view->screenW ? -(view->screenW - w) / 2 : mini(maxi(view->x, 0), w - view->screenW);
+  view->y = h <= view->screenH ? -(view->screenH - h) / 2 : mini(maxi(view->y, 0), h - view->screenH);
+}
+
+void viewportPan(struct viewport *view, int dx, int dy)
+{
+  view->x += dx;
+  view->y += dy;
+  clamp(view);
+}
+
+void viewportZoom(struct viewport *view, int zoom, int x, int y)
+{
+  zoom = mini(maxi(zoom, 1), VIEWPORT_ZOOM);
+  view->x = (view->x + x) / view->zoom * zoom - x;
+  view->y = (view->y + y) / view->zoom * zoom - y;
+  view->zoom = zoom;
+  clamp(view);
+}
+
+void viewportPosition(const struct viewport *view, int *x, int *y, int *zoom)
+{
+  *x = maxi(view->x, 0) / view->zoom;
+  *y = maxi(view->y, 0) / view->zoom;
+  *zoom = view->zoom;
+}
+
+static bool renderTile(struct viewport *view, struct tile *t)
+{
+  if (!t->surface) {
+    t->surface = SDL_CreateRGBSurface(SDL_SWSURFACE, VIEWPORT_TILE, VIEWPORT_TILE + MARGIN, 32,
+                                      view->Rmask, view->Gmask, view->Bmask, view->Amask);
+    if (!t->surface) {
+      fprintf(stderr, "SDL_CreateRGBSurface: %s\n", SDL_GetError());
+      return false;
+    }
+  }
+  // card pixel x, y is the first pixel of the tile
+  int x = t->tx * VIEWPORT_TILE, y = t->ty * VIEWPORT_TILE;
+  view->render(t->surface, x, y, mini(VIEWPORT_TILE, view->w - x), mini(VIEWPORT_TILE + MARGIN, view->h - y), view->data);
+  return true;
+}
+
+static struct tile *getTile(struct viewport *view, int tx, int ty)
+{
+  struct tile *oldest = &view->tiles[0];
+  for (int i = 0; i < view->capacity; ++i) {
+    struct tile *t = &view->tiles[i];
+    if (t->tx == tx && t->ty == ty) {
+      t->used = ++view->clock;
+      return t;
+    }
+    if (t->used < oldest->used) oldest = t;
+  }
+
+  oldest->tx = tx;
+  oldest->ty = ty;
+  if (!renderTile(view, oldest)) {
+    oldest->tx = oldest->ty = -1;
+    oldest->used = 0;
+    return NULL;
+  }
+  oldest->used = ++view->clock;
+  return oldest;
+}
+
+// Draw card pixels x0..x1, y0..y1 of a tile as zoom by zoom blocks.
+static void magnify(const struct viewport *view, SDL_Surface *screen, const struct tile *t,
+                    int x0, int y0, int x1, int y1)
+{
+  int z = view->zoom;
+  const SDL_Surface *s = t->surface;
+  int ox = t->tx * VIEWPORT_TILE, oy = t->ty * VIEWPORT_TILE;
+  int sx0 = maxi(x0 * z - view->x, 0), sx1 = mini(x1 * z - view->x, screen->w);
+  for (int j = y0; j < y1; ++j) {
+    const Uint32 *src = (const Uint32 *)((const Uint8 *)s->pixels + (j - oy) * s->pitch);
+    int sy0 = maxi(j * z - view->y, 0), sy1 = mini((j + 1) * z - view->y, screen->h);
+    if (sy0 >= sy1) continue;
+    Uint32 *row = (Uint32 *)((Uint8 *)screen->pixels + sy0 * screen->pitch);
+    for (int sx = sx0; sx < sx1; ++sx) {
+      row[sx] = src[(sx + view->x) / z - ox];
+    }
+    for (int sy = sy0 + 1; sy < sy1; ++sy) {
+      memcpy((Uint8 *)screen->pixels + sy * screen->pitch + 4 * sx0, row + sx0, 4 * (sx1 - sx0));
+    }
+  }
+}
+
+void viewportDraw(struct viewport *view, SDL_Surface *screen)
+{
+  view->screenW = screen->w;
+  view->screenH = screen->h;
+  clamp(view);
+
+  int z = view->zoom;
+  if (view->x < 0 || view->y < 0) {
+    SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 0, 0, 0));
+  }
+
+  // the card pixels on the screen
+  int cx0 = maxi(view->x, 0) / z, cy0 = maxi(view->y, 0) / z;
+  int cx1 = mini((view->x + screen->w + z - 1) / z, view->w);
+  int cy1 = mini((view->y + screen->h + z - 1) / z, view->h);
+
+  for (int ty = cy0 / VIEWPORT_TILE; ty * VIEWPORT_TILE < cy1; ++ty) {
+    for (int tx = cx0 / VIEWPORT_TILE; tx * VIEWPORT_TILE < cx1; ++tx) {
+      const struct tile *t = getTile(view, tx, ty);
+      if (!t) continue;
+      int x0 = maxi(tx * VIEWPORT_TILE, cx0), x1 = mini((tx + 1) * VIEWPORT_TILE, cx1);
+      int y0 = maxi(ty * VIEWPORT_TILE, cy0), y1 = mini((ty + 1) * VIEWPORT_TILE, cy1);
+      if (z == 1) {
+        SDL_Rect src = {x0 - tx * VIEWPORT_TILE, y0 - ty * VIEWPORT_TILE, x1 - x0, y1 - y0};
+        SDL_Rect dst = {x0 - view->x, y0 - view->y, 0, 0};
+        SDL_BlitSurface(t->surface, &src, screen, &dst);
+        continue;
+      }
+      if(SDL_MUSTLOCK(screen)) {
+        if(SDL_LockSurface(screen) < 0 ) {
+          fprintf(stderr, "SDL_LockSurface: %s\n", SDL_GetError());
+          return;
+        }
+      }
+      magnify(view, screen, t, x0, y0, x1, y1);
+      if(SDL_MUSTLOCK(screen)) {
+        SDL_UnlockSurface(screen);
+      }
+    }
+  }
+}
@@ -0,0 +1,51 @@
+/*
+ * Test Card - Pan and zoom viewport for cards bigger than the screen
+ *
+ * The card keeps its own resolution, e.g. 15360x8640 on a 1080p
+ * window, and the screen shows a part of it at 1:1 or magnified by an
+ * integer zoom. The card is never rendered as a whole: it is cut into
+ * VIEWPORT_TILE pixel square tiles and only the visible ones are
+ * rendered, each as a region of the card (see cardRender() in card.h).
+ * Rendered tiles are kept in a least recently used cache of about
+ * twice what fits on the screen.
+ *
+ * This program is licensed under the GPL2 and the full license text
+ * should have been included with the source code (see file COPYING).
+ */
+#ifndef TESTCARD_VIEWPORT_H
+#define TESTCARD_VIEWPORT_H
+
+#include <SDL.h>
+
+#define VIEWPORT_TILE 256
+// Cards can not be bigger than what SDL_Rect can address
+#define VIEWPORT_MAX  32767
+#define VIEWPORT_ZOOM 32
+
+struct viewport;
+
+// Paints the w by h pixels of the card starting at x, y into the
+// top-left corner of tile.
+typedef void (*viewportRender)(SDL_Surface *tile, int x, int y, int w, int h, void *data);
+
+// A viewport of a w by h card on screen, NULL when out of memory.
+struct viewport *viewportCreate(int w, int h, const SDL_Surface *screen, viewportRender render, void *data);
+void viewportFree(struct viewport *view);
+
+// Forget the rendered tiles, e.g. after changing modes.
+void viewportInvalidate(struct viewport *view);
+
+// Move by dx, dy screen pixels.
+void viewportPan(struct viewport *view, int dx, int dy);
+
+// Change the zoom keeping the card pixel under screen pixel x, y where
+// it is.
+void viewportZoom(struct viewport *view, int zoom, int x, int y);
+
+// Zoom and the card pixel in the top-left corner of the screen.
+void viewportPosition(const struct viewport *view, int *x, int *y, int *zoom);
+
+// Draw the visible part of the card, rendering tiles as needed.
+void viewportDraw(struct viewport *view, SDL_Surface *screen);
+
+#endif
@@ -25,6 +25,7 @@ A = matrix([
     [ 0.5 * (1.0 - kr) / (1 - kr), 0.5 * (-(1 - kr -kb)) / (1 - kr), 0.5 * (-kb) / (1 - kr)]
 ])
 B = linalg.inv(A)
+D = A.copy()
 
 
 A[0] *= 65536 * 219 / 255
@@ -52,3 +53,20 @@ print('cr -= 128')
 print('(%d + %d*y + %d*cb + %d*cr)>>16'%tuple(map(int, B[0])))
 print('(%d + %d*y + %d*cb + %d*cr)>>16'%tuple(map(int, B[1])))
 print('(%d + %d*y + %d*cb + %d*cr)>>16'%tuple(map(int, B[2])))
+
+# 16-bit RGB shifted down to 15 bits (so it fits the signed 16-bit
+# multiplies of SSE2) to 10-bit YCbCr with 20-bit fraction.
+D[0] *= 1048576 / 32767 * 876
+D[1:] *= 1048576 / 32767 * 896
+D = D.round().tolist()
+D[0].insert(0, 64*1048576 + 524288)
+for i in range(1,3):
+    D[i].insert(0, 512*1048576 + 524288)
+print()
+print('16-bit RGB to 10-bit YCbCr:')
+print('r >>= 1')
+print('g >>= 1')
+print('b >>= 1')
+print('(%d + %d*r + %d*g + %d*b)>>20'%tuple(map(int, D[0])))
+print('(%d + %d*r + %d*g + %d*b)>>20'%tuple(map(int, D[1])))
+print('(%d + %d*r + %d*g + %d*b)>>20'%tuple(map(int, D[2])))